@@ -0,0 +1,290 @@
+/*******************************************************************************************
+*
+*   libpartikel benchmark - Run the demo effects headless and measure them.
+*
+*   Every preset of demo.c is updated for a fixed amount of ticks with a fixed dt.
+*   Only the simulation is built, so neither raylib nor a window are needed.
+*   Reports the time per particle update including the emission of new particles, the time
+*   per spawned particle, the peak amount of live particles and the memory allocated by the
+*   library, as CSV or JSON.
+*
+*   Usage: partikel_bench [--ticks N] [--dt SECONDS] [--threads N] [--format csv|json]
+*
+*   libpartikel is licensed under an unmodified zlib/libpng license (View partikel.h for details)
+*
+********************************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L  // clock_gettime
+
+#include "stddef.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+// Allocation tracking.
+//----------------------------------------------------------------------------------
+
+// Every allocation is prefixed with its size, so frees can be accounted for.
+typedef union AllocHeader {
+    size_t size;
+    max_align_t align;
+} AllocHeader;
+
+static size_t bytesAllocated = 0;   // Sum of all allocations.
+static size_t bytesInUse = 0;
+static size_t bytesPeak = 0;        // Most bytes in use at once.
+
+static void * BenchRealloc(void *ptr, size_t size) {
+    AllocHeader *header = ptr != NULL ? (AllocHeader *)ptr - 1 : NULL;
+    size_t old = header != NULL ? header->size : 0;
+
+    header = realloc(header, sizeof(AllocHeader) + size);
+    if(header == NULL) {
+        return NULL;
+    }
+    header->size = size;
+
+    bytesInUse = bytesInUse - old + size;
+    bytesAllocated += size > old ? size - old : 0;
+    if(bytesInUse > bytesPeak) {
+        bytesPeak = bytesInUse;
+    }
+    return header + 1;
+}
+
+static void * BenchCalloc(size_t count, size_t size) {
+    void *ptr = BenchRealloc(NULL, count * size);
+    if(ptr != NULL) {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+static void BenchFree(void *ptr) {
+    if(ptr == NULL) {
+        return;
+    }
+    AllocHeader *header = (AllocHeader *)ptr - 1;
+    bytesInUse -= header->size;
+    free(header);
+}
+
+#define PARTIKEL_CALLOC(count, size) BenchCalloc(count, size)
+#define PARTIKEL_REALLOC(ptr, size) BenchRealloc(ptr, size)
+#define PARTIKEL_FREE(ptr) BenchFree(ptr)
+
+#define PARTIKEL_NO_RAYLIB
+#define LIBPARTIKEL_IMPLEMENTATION
+#include "partikel.h"
+#include "presets.h"
+
+// Global data.
+//----------------------------------------------------------------------------------
+
+// The demo's camera, which its deactivators depend on.
+static const Vector2 cameraOffset = {.x = 500, .y = 400};
+
+// Ticks between two bursts, like a click every second in the demo.
+#define BURST_INTERVAL 60
+
+// Preset is one effect of demo.c, see presets.h.
+typedef struct Preset {
+    const char *name;
+    unsigned int (*configs)(EmitterConfig cfgs[PRESET_MAX_EMITTERS]);
+    int burstInterval;
+} Preset;
+
+// Result holds the measurements of one preset.
+typedef struct Result {
+    const char *name;
+    double nsPerUpdate;         // Per particle and tick, including emission.
+    double nsPerSpawn;          // Per spawned particle.
+    unsigned long peakLive;
+    size_t bytesAllocated;
+    size_t bytesPeak;
+} Result;
+
+// Same deactivators as the demo, with the camera fixed at the origin.
+bool Particle_DeactivatorFountain(Particle *p) {
+    return (p->position.y > cameraOffset.y // bottom
+            || p->position.x < -cameraOffset.x // left
+            || p->position.x > cameraOffset.x // right
+            || Particle_DeactivatorAge(p));
+}
+
+bool Particle_DeactivatorOutsideCam(Particle *p) {
+    return (p->position.y < -cameraOffset.y
+            || Particle_DeactivatorAge(p));
+}
+
+void OOMExit() {
+    fprintf(stderr, "OUT OF MEMORY.. BYE\n");
+    exit(1);
+}
+
+static const Preset presets[] = {
+    {.name = "fountain", .configs = PresetFountain, .burstInterval = BURST_INTERVAL},
+    {.name = "swirl", .configs = PresetSwirl, .burstInterval = BURST_INTERVAL},
+    {.name = "flame", .configs = PresetFlame, .burstInterval = BURST_INTERVAL},
+    // Fired rapidly, it only emits through bursts.
+    {.name = "muzzle_flash", .configs = PresetMuzzleFlash, .burstInterval = 6},
+};
+
+// Measurement.
+//----------------------------------------------------------------------------------
+
+// Now returns a monotonic timestamp in nanoseconds.
+static double Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// NewSystem creates a system with the Emitters of preset.
+ParticleSystem * NewSystem(const Preset *preset) {
+    ParticleSystem *ps = ParticleSystem_New();
+    if(ps == NULL) {
+        OOMExit();
+    }
+
+    EmitterConfig cfgs[PRESET_MAX_EMITTERS];
+    unsigned int count = preset->configs(cfgs);
+    for(unsigned int i = 0; i < count; i++) {
+        // Fixed seeds, so every run simulates exactly the same particles.
+        cfgs[i].seed = i + 1;
+        Emitter *e = Emitter_New(cfgs[i]);
+        if(e == NULL || !ParticleSystem_Register(ps, e)) {
+            OOMExit();
+        }
+    }
+    return ps;
+}
+
+// Run updates preset for ticks steps of dt and measures it.
+// Memory is measured for the updates only.
+Result Run(const Preset *preset, unsigned int ticks, float dt, ThreadPool *pool) {
+    Result r = {.name = preset->name};
+    bytesAllocated = 0;
+    bytesPeak = bytesInUse;
+    size_t baseline = bytesInUse;
+
+    ParticleSystem *ps = NewSystem(preset);
+    ParticleSystem_SetThreadPool(ps, pool);
+    ParticleSystem_Start(ps);
+
+    // Updates, with a burst at a moving origin from time to time.
+    double updateTime = 0;
+    double updated = 0;
+    for(unsigned int t = 0; t < ticks; t++) {
+        if(preset->burstInterval > 0 && t % (unsigned int)preset->burstInterval == 0) {
+            ParticleSystem_SetOrigin(ps, (Vector2){.x = (float)(t % 200) - 100, .y = 0});
+            ParticleSystem_Burst(ps);
+        }
+
+        updated += (double)ParticleSystem_LiveCount(ps);
+        double start = Now();
+        unsigned long live = ParticleSystem_Update(ps, dt);
+        updateTime += Now() - start;
+
+        if(live > r.peakLive) {
+            r.peakLive = live;
+        }
+    }
+    r.nsPerUpdate = updated > 0 ? updateTime / updated : 0;
+
+    ParticleSystem_FreeAll(ps);
+    r.bytesAllocated = bytesAllocated;
+    r.bytesPeak = bytesPeak - baseline;
+
+    // Spawns, filling the Emitters of a fresh system up from empty again and again.
+    double spawnTime = 0;
+    double spawned = 0;
+    for(unsigned int t = 0; t < ticks; t += BURST_INTERVAL) {
+        ps = NewSystem(preset);
+        for(unsigned int i = 0; i < ps->length; i++) {
+            Emitter *e = ps->emitters[i];
+
+            double start = Now();
+            spawned += (double)Emitter_SpawnBatch(e, e->config.capacity);
+            spawnTime += Now() - start;
+        }
+        ParticleSystem_FreeAll(ps);
+    }
+    r.nsPerSpawn = spawned > 0 ? spawnTime / spawned : 0;
+
+    return r;
+}
+
+void PrintUsage(const char *program) {
+    fprintf(stderr, "Usage: %s [--ticks N] [--dt SECONDS] [--threads N] [--format csv|json]\n", program);
+}
+
+int main(int argc, char * argv[argc + 1]) {
+    unsigned int ticks = 6000;
+    float dt = 1.0f / 60.0f;
+    int threads = -1;
+    bool json = false;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            ticks = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--dt") == 0 && i + 1 < argc) {
+            dt = strtof(argv[++i], NULL);
+        } else if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if(strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            json = strcmp(argv[i], "json") == 0;
+            if(!json && strcmp(argv[i], "csv") != 0) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+#ifndef PARTIKEL_THREADS
+    // Without threading ThreadPool_New always fails, every run would be single threaded.
+    if(threads >= 0) {
+        fprintf(stderr, "--threads needs a build with PARTIKEL_THREADS\n");
+        return 1;
+    }
+#endif
+
+    // No pool unless asked for, ThreadPool_New(0) sizes it to the machine.
+    ThreadPool *pool = threads >= 0 ? ThreadPool_New((unsigned int)threads) : NULL;
+    if(threads >= 0 && pool == NULL) {
+        OOMExit();
+    }
+
+    unsigned int count = sizeof(presets) / sizeof(presets[0]);
+    if(json) {
+        printf("{\"ticks\": %u, \"dt\": %g, \"simd\": %d, \"results\": [\n", ticks, dt, (int)ParticleArrays_GetSimdLevel());
+    } else {
+        printf("preset,ticks,dt,ns_per_update_with_emission,ns_per_spawn,peak_live,bytes_allocated,bytes_peak\n");
+    }
+
+    for(unsigned int i = 0; i < count; i++) {
+        Result r = Run(&presets[i], ticks, dt, pool);
+        if(json) {
+            printf("  {\"preset\": \"%s\", \"ns_per_update_with_emission\": %.3f, \"ns_per_spawn\": %.3f, "
+                   "\"peak_live\": %lu, \"bytes_allocated\": %zu, \"bytes_peak\": %zu}%s\n",
+                   r.name, r.nsPerUpdate, r.nsPerSpawn, r.peakLive, r.bytesAllocated, r.bytesPeak,
+                   i + 1 < count ? "," : "");
+        } else {
+            printf("%s,%u,%g,%.3f,%.3f,%lu,%zu,%zu\n",
+                   r.name, ticks, dt, r.nsPerUpdate, r.nsPerSpawn, r.peakLive, r.bytesAllocated, r.bytesPeak);
+        }
+    }
+
+    if(json) {
+        printf("]}\n");
+    }
+
+    ThreadPool_Free(pool);
+
+    return 0;
+}
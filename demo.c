@@ -18,6 +18,7 @@
 #include "stdio.h"
 #include "raylib.h"
 #include "partikel.h"
+#include "presets.h"
 
 // Global data.
 //----------------------------------------------------------------------------------
@@ -75,48 +76,25 @@ void InitFountain() {
         OOMExit();
     }
 
-    EmitterConfig ecfg1 = {
-        .capacity = 600,
-        .emissionRate = 200,
-        .origin = (Vector2){.x = 0, .y = 0},
-        .originAcceleration = (FloatRange){.min = 0, .max = 0},
-        .direction = (Vector2){.x = 0, .y = -1}, // go up
-        .directionAngle = (FloatRange){.min = -6, .max = 6}, // angle range -8 to +8 degree deviation from direction
-        .velocityAngle = (FloatRange){.min = 0, .max = 0},
-        .velocity = (FloatRange){.min = 700, .max = 730},
-        .externalAcceleration = (Vector2){.x = 0, .y = 981},
-        .baseScale = (Vector2){0.2, 0.2},
-        .scaleIncrease = (Vector2){0.8, 0.8},
-        .startColor = (Color){.r = 0, .g = 20, .b = 255, .a = 255},
-        .endColor = (Color){.r = 0, .g = 150, .b = 100, .a = 0},
-        .age = (FloatRange){.min = 1.0, .max = 3.0},
-        .texture = texCircle16,
-        .blendMode = BLEND_ADDITIVE,
-
-        .particle_Deactivator = Particle_DeactivatorFountain
-    };
-    emitterFountain1 = Emitter_New(ecfg1);
+    EmitterConfig cfgs[PRESET_MAX_EMITTERS];
+    PresetFountain(cfgs);
+    cfgs[0].texture = texCircle16;
+    cfgs[1].texture = texCircle8;
+    cfgs[2].texture = texCircle16;
+
+    emitterFountain1 = Emitter_New(cfgs[0]);
     if(emitterFountain1 == NULL) {
         OOMExit();
     }
     ParticleSystem_Register(ps1, emitterFountain1);
 
-    ecfg1.directionAngle = (FloatRange){.min = -1.5, .max = 1.5};
-    ecfg1.velocity = (FloatRange){.min = 800, .max = 850};
-    ecfg1.texture = texCircle8;
-    emitterFountain2 = Emitter_New(ecfg1);
+    emitterFountain2 = Emitter_New(cfgs[1]);
     if(emitterFountain2 == NULL) {
         OOMExit();
     }
     ParticleSystem_Register(ps1, emitterFountain2);
 
-    ecfg1.capacity = 3000;
-    ecfg1.emissionRate = 1000;
-    ecfg1.directionAngle = (FloatRange){.min = -20, .max = 20};
-    ecfg1.velocity = (FloatRange){.min = 500, .max = 550};
-    ecfg1.texture = texCircle16;
-    ecfg1.age = (FloatRange){.min = 0.0, .max = 3.0};
-    emitterFountain3 = Emitter_New(ecfg1);
+    emitterFountain3 = Emitter_New(cfgs[2]);
     if(emitterFountain3 == NULL) {
         OOMExit();
     }
@@ -131,52 +109,25 @@ void InitSwirl() {
         OOMExit();
     }
 
-    EmitterConfig ecfg = {
-        .capacity = 2500,
-        .emissionRate = 500,
-        .origin = (Vector2){.x = 0, .y = 0},
-        .originAcceleration = (FloatRange){.min = 400, .max = 500},
-        .offset = (FloatRange){.min = 30, .max = 40},
-        .direction = (Vector2){.x = 0, .y = -1}, // go up
-        .directionAngle = (FloatRange){.min = -180, .max = 180},
-        .velocityAngle = (FloatRange){.min = 90, .max = 90},
-        .velocity = (FloatRange){.min = 200, .max = 500},
-        .baseScale = (Vector2){0.2, 0.2},
-        .startColor = (Color){.r = 244, .g = 20, .b = 0, .a = 255},
-        .endColor = (Color){.r = 244, .g = 20, .b = 0, .a = 0},
-        .age = (FloatRange){.min = 2.5, .max = 5.0},
-        .texture = texCircle8,
-        .blendMode = BLEND_ADDITIVE,
-
-        .particle_Deactivator = Particle_DeactivatorOutsideCam
-    };
-
-    emitterSwirl1 = Emitter_New(ecfg);
+    EmitterConfig cfgs[PRESET_MAX_EMITTERS];
+    PresetSwirl(cfgs);
+    cfgs[0].texture = texCircle8;
+    cfgs[1].texture = texCircle8;
+    cfgs[2].texture = texCircle8;
+
+    emitterSwirl1 = Emitter_New(cfgs[0]);
     if(emitterSwirl1 == NULL) {
         OOMExit();
     }
     ParticleSystem_Register(ps2, emitterSwirl1);
 
-    ecfg.capacity = 1000;
-    ecfg.emissionRate = 200;
-    ecfg.offset = (FloatRange){.min = 40, .max = 50};
-    ecfg.startColor = (Color){.r = 244, .g = 0, .b = 111, .a = 255};
-    ecfg.endColor = (Color){.r = 244, .g = 0, .b = 111, .a = 0};
-
-    emitterSwirl2 = Emitter_New(ecfg);
+    emitterSwirl2 = Emitter_New(cfgs[1]);
     if(emitterSwirl2 == NULL) {
         OOMExit();
     }
     ParticleSystem_Register(ps2, emitterSwirl2);
 
-    ecfg.capacity = 150;
-    ecfg.emissionRate = 30;
-    ecfg.offset = (FloatRange){.min = 20, .max = 30};
-    ecfg.velocity = (FloatRange){.min = 100, .max = 200};
-    ecfg.startColor = (Color){.r = 255, .g = 211, .b = 0, .a = 255};
-    ecfg.endColor = (Color){.r = 255, .g = 211, .b = 0, .a = 0};
-
-    emitterSwirl3 = Emitter_New(ecfg);
+    emitterSwirl3 = Emitter_New(cfgs[2]);
     if(emitterSwirl3 == NULL) {
         OOMExit();
     }
@@ -191,62 +142,33 @@ void InitFlame() {
         OOMExit();
     }
 
-    EmitterConfig ecfg = {
-        .capacity = 1000,
-        .emissionRate = 500,
-        .origin = (Vector2){.x = 0, .y = 0},
-        .originAcceleration = (FloatRange){.min = 50, .max = 100},
-        .offset = (FloatRange){.min = 0, .max = 10},
-        .direction = (Vector2){.x = 0, .y = -1}, // go up
-        .directionAngle = (FloatRange){.min = -90, .max = -90},
-        .velocityAngle = (FloatRange){.min = 90, .max = 90},
-        .velocity = (FloatRange){.min = 30, .max = 150},
-        .baseScale = (Vector2){0.4, 0.4},
-        .startColor = (Color){.r = 255, .g = 20, .b = 0, .a = 255},
-        .endColor = (Color){.r = 255, .g = 20, .b = 0, .a = 0},
-        .age = (FloatRange){.min = 1.0, .max = 2.0},
-        .texture = texCircle16,
-        .blendMode = BLEND_ADDITIVE,
-
-        .particle_Deactivator = Particle_DeactivatorFountain
-    };
-
-    emitterFlame1 = Emitter_New(ecfg);
+    EmitterConfig cfgs[PRESET_MAX_EMITTERS];
+    PresetFlame(cfgs);
+    cfgs[0].texture = texCircle16;
+    cfgs[1].texture = texCircle16;
+    cfgs[2].texture = texCircle16;
+
+    emitterFlame1 = Emitter_New(cfgs[0]);
     if(emitterFlame1 == NULL) {
         OOMExit();
     }
     ParticleSystem_Register(ps3, emitterFlame1);
 
-    ecfg.capacity = 20;
-    ecfg.emissionRate = 20;
-    ecfg.startColor = (Color){.r = 255, .g = 255, .b = 255, .a = 255};
-    ecfg.endColor = (Color){.r = 255, .g = 255, .b = 255, .a = 0};
-    ecfg.age = (FloatRange){.min = 0.5, .max = 1.0};
-
-    emitterFlame2 = Emitter_New(ecfg);
+    emitterFlame2 = Emitter_New(cfgs[1]);
     if(emitterFlame2 == NULL) {
         OOMExit();
     }
     ParticleSystem_Register(ps3, emitterFlame2);
 
-
-    ecfg.capacity = 500;
-    ecfg.emissionRate = 100;
-    ecfg.directionAngle = (FloatRange){.min = -3, .max = 3};
-    ecfg.velocityAngle = (FloatRange){.min = 0, .max = 0};
-    ecfg.originAcceleration = (FloatRange){.min = 0, .max = 0};
-    ecfg.startColor = (Color){.r = 125, .g = 125, .b = 125, .a = 30};
-    ecfg.endColor = (Color){.r = 125, .g = 125, .b = 125, .a = 10};
-    ecfg.age = (FloatRange){.min = 3.0, .max = 5.0};
-
-    emitterFlame3 = Emitter_New(ecfg);
+    emitterFlame3 = Emitter_New(cfgs[2]);
     if(emitterFlame3 == NULL) {
         OOMExit();
     }
     ParticleSystem_Register(ps3, emitterFlame3);
 
-
     ParticleSystem_Start(ps3);
+    // Start with the smoke already rising instead of waiting for it.
+    ParticleSystem_Prewarm(ps3, 5.0f);
 }
 
 void InitMuzzleFlash() {
@@ -255,29 +177,11 @@ void InitMuzzleFlash() {
         OOMExit();
     } 
 
-    EmitterConfig ecfg = {
-        .capacity = 10,
-        .emissionRate = 0,
-        .burst = (IntRange){.min = 1, .max = 1},
-        .origin = (Vector2){.x = 0, .y = 0},
-        .originAcceleration = (FloatRange){.min = 0, .max = 0},
-        .offset = (FloatRange){.min = 0, .max = 0},
-        .direction = (Vector2){.x = 0, .y = 0}, // go up
-        .directionAngle = (FloatRange){.min = 0, .max = 0},
-        .velocityAngle = (FloatRange){.min = 0, .max = 0},
-        .velocity = (FloatRange){.min = 0, .max = 0},
-        .baseScale = (Vector2){1, 1},
-        .scaleIncrease = (Vector2){0, 2},
-        .startColor = (Color){.r = 255, .g = 20, .b = 0, .a = 255},
-        .endColor = (Color){.r = 255, .g = 20, .b = 0, .a = 0},
-        .age = (FloatRange){.min = 0.2, .max = 0.2},
-        .texture = muzzleFlashTexture,
-        .blendMode = BLEND_ADDITIVE,
-
-        .particle_Deactivator = Particle_DeactivatorFountain
-    };
-
-    emitterMuzzle1 = Emitter_New(ecfg);
+    EmitterConfig cfgs[PRESET_MAX_EMITTERS];
+    PresetMuzzleFlash(cfgs);
+    cfgs[0].texture = muzzleFlashTexture;
+
+    emitterMuzzle1 = Emitter_New(cfgs[0]);
     if(emitterMuzzle1 == NULL) {
         OOMExit();
     }
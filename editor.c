@@ -80,27 +80,12 @@ static void DrawColorPicker(const char *name, Vector2 pos, Color *color);
 static void DrawAlphaPicker(const char *name, Vector2 pos, unsigned char *alpha);
 static void InitParticleSystem(void);
 static Color HexToRGB(int hex);
-static void DrawParticle(Emitter *e, Particle *p);
 
 // --- Importing/Exporting ---
 
 static bool Export(void);
 static bool Import(const char *path);
-static int WriteEmitterIntValue(char *str, size_t size, int val);
-static int WriteEmitterFloatValue(char *str, size_t size, float val);
-static int WriteEmitterFloatRange(char *str, size_t size, FloatRange val);
-static int WriteEmitterIntRange(char *str, size_t size, IntRange val);
-static int WriteEmitterVector2(char *str, size_t size, Vector2 val);
-static int WriteEmitterColor(char *str, size_t size, Color val);
-static int WriteEmitterString(char *str, size_t size, const char *to_write);
-static int ReadEmitterIntValue(char *str, int *val);
-static int ReadEmitterFloatValue(char *str, float *val);
-static int ReadEmitterFloatRange(char *str, FloatRange *val);
-static int ReadEmitterIntRange(char *str, IntRange *val);
-static int ReadEmitterVector2(char *str, Vector2 *val);
-static int ReadEmitterColor(char *str, Color *val);
-static int ReadEmitterString(char *str, char *read_str);
-static const char *GetExportCommentLine(void);
+static Texture2D ResolveTexture(const char *path, void *user);
 
 // ---------------------------
 
@@ -112,19 +97,26 @@ typedef struct
     char texture_path[512];
     Emitter *emitter;
     RenderTexture2D particle_editor_render_tex;
-    char metadata[512];
 } EmitterControl;
 
 static EmitterControl emitters[EMITTER_COUNT] = {
-    {.id = 0, .metadata = {0}},
-    {.id = 1, .metadata = {0}},
-    {.id = 2, .metadata = {0}},
-    {.id = 3, .metadata = {0}},
-    {.id = 4, .metadata = {0}},
-    {.id = 5, .metadata = {0}},
-    {.id = 6, .metadata = {0}},
-    {.id = 7, .metadata = {0}},
+    {.id = 0},
+    {.id = 1},
+    {.id = 2},
+    {.id = 3},
+    {.id = 4},
+    {.id = 5},
+    {.id = 6},
+    {.id = 7},
 };
+// textures loaded while importing a file, in the order the loader asked for them
+typedef struct
+{
+    int count;
+    Texture2D textures[EMITTER_COUNT];
+    char paths[EMITTER_COUNT][512];
+} ImportState;
+
 static EmitterControl *selected_emitter = NULL;
 static GuiFileDialogState sprite_dialog_state;
 static GuiFileDialogState import_dialog_state;
@@ -156,7 +148,6 @@ static EmitterConfig base_cfg = {
     .age = (FloatRange){0.5, 0.5},
     .blendMode = BLEND_ADDITIVE,
     .rotationSpeed = (FloatRange){0, 0},
-    .particle_Draw = DrawParticle
 };
 
 static ParticleSystem *ps = NULL;
@@ -425,12 +416,20 @@ static void DrawEmittersBar()
 
 static void DrawEmittersControls(void)
 {
-    selected_emitter->emitter->config.capacity = (int)GuiSlider(
+    unsigned int capacity = (int)GuiSlider(
         (Rectangle){CONTROLS_RECT.x + SPRITE_EDITOR_RECT.width + 225, CONTROLS_RECT.y + 40, 175, 20},
         "Capacity", "",
         selected_emitter->emitter->config.capacity,
         1, 5000);
 
+    if (capacity != selected_emitter->emitter->config.capacity)
+    {
+        EmitterConfig cfg = selected_emitter->emitter->config;
+
+        cfg.capacity = capacity;
+        Emitter_Reinit(selected_emitter->emitter, cfg);
+    }
+
     GuiLabel(
         (Rectangle){CONTROLS_RECT.x + SPRITE_EDITOR_RECT.width + 225 + 120, CONTROLS_RECT.y + 40, 175, 20},
         TextFormat("%d", selected_emitter->emitter->config.capacity));
@@ -533,6 +532,9 @@ static void DrawEmittersControls(void)
         (Vector2){x, y + (COLOR_PICKER_HEIGHT * 2 + ALPHA_PICKER_HEIGHT) + 80},
         &selected_emitter->emitter->config.endColor.a);
 
+    // Colors are edited in place, keep the baked colors in sync
+    Emitter_BakeLUT(selected_emitter->emitter);
+
     GuiUnlock();
 
     GuiFileDialog(&sprite_dialog_state);
@@ -699,447 +701,111 @@ static Color HexToRGB(int hex)
     return color;
 }
 
-static void DrawParticle(Emitter *e, Particle *p)
-{
-    DrawTexturePro(
-        e->config.texture,
-        (Rectangle){0, 0, e->config.texture.width, e->config.texture.height},
-        (Rectangle){p->position.x - e->offset.x, p->position.y - e->offset.y, e->config.texture.width * p->scale.x, e->config.texture.height * p->scale.y},
-        (Vector2){e->config.textureOrigin.x * p->scale.x, e->config.textureOrigin.y * p->scale.y},
-        p->rotation,
-        LinearFade(e->config.startColor, e->config.endColor, p->age / p->ttl));
-}
-
 static bool Export(void)
 {
-    // TODO: open a popup to select file name when no file has been imported
-    FILE *f = fopen(has_imported_file ? selected_file : "foobar", "w");
-
-    if (!f)
-        return false;
-
-    if (fputs(GetExportCommentLine(), f) < 0)
-        return false;
+    const char *texture_paths[EMITTER_COUNT];
 
     for (int i = 0; i < EMITTER_COUNT; i++)
-    {
-        EmitterControl *ec = &emitters[i];
-        Emitter *e = ec->emitter;
-
-        char emitter_str[1024] = {0};
-        int cursor = 0;
-        int len;
-
-        if ((len = WriteEmitterIntValue(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, (int)e->isActive)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterVector2(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.direction)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterFloatRange(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.velocity)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterFloatRange(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.directionAngle)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterFloatRange(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.velocityAngle)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterFloatRange(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.offset)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterFloatRange(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.originAcceleration)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterIntRange(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.burst)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterIntValue(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.capacity)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterVector2(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.origin)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterVector2(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.externalAcceleration)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterVector2(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.baseScale)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterVector2(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.scaleIncrease)) < 0)
-            goto write_error;
+        texture_paths[i] = emitters[i].texture_path;
 
-        cursor += len;
-
-        if ((len = WriteEmitterColor(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.startColor)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterColor(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.endColor)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterFloatRange(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.age)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterFloatValue(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.baseRotation)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterFloatRange(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.rotationSpeed)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        if ((len = WriteEmitterVector2(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, e->config.textureOrigin)) < 0)
-            goto write_error;
-
-        cursor += len;
-
-        char path_and_meta[512] = {0};
-
-        snprintf(path_and_meta, sizeof(path_and_meta), "%s|%s", ec->texture_path, ec->metadata);
-
-        if ((len = WriteEmitterString(emitter_str + cursor, sizeof(emitter_str) - cursor - 1, path_and_meta)) < 0)
-            goto write_error;
-
-        if (fputs(emitter_str, f) < 0)
-            goto write_error;
-        if (fputs("\n", f) < 0)
-            goto write_error;
-    }
-
-    fclose(f);
-    return true;
-
-write_error:
-    fclose(f);
-
-    return false;
+    // TODO: open a popup to select file name when no file has been imported
+    return ParticleSystem_SaveToFile(ps, texture_paths, has_imported_file ? selected_file : "foobar");
 }
 
 static bool Import(const char *path)
 {
-    FILE *f = fopen(path, "r");
+    ImportState state = {0};
+    ParticleSystem *loaded = ParticleSystem_LoadFromFile(path, ResolveTexture, &state);
+
+    if (!loaded)
+    {
+        printf("Failed to read %s\n", path);
+
+        for (int i = 0; i < state.count; i++)
+            UnloadTexture(state.textures[i]);
 
-    if (!f)
         return false;
+    }
 
-    char *line = NULL;
-    size_t line_len = 0;
-    int len = 0;
-    int cursor = 0;
-    int i = 0;
-    int read_token_count = 0;
+    bool res = true;
 
-    while (getline(&line, &line_len, f) != -1)
+    for (int i = 0; i < EMITTER_COUNT; i++)
     {
-        if (line[0] == '#')
-            continue;
-
         EmitterControl *ec = &emitters[i];
-        Emitter *e = ec->emitter;
-        char *tokens[32];
-
-        char *token = strtok(line, "|");
-        int token_count = 0;
 
-        while (token != NULL)
+        if (i >= (int)loaded->length)
         {
-            tokens[token_count++] = token;
-            token = strtok(NULL, "|");
+            ec->emitter->isActive = false;
+            Emitter_SetMetadata(ec->emitter, NULL);
+            continue;
         }
 
-        read_token_count = 0;
-
-        int is_active;
-
-        if (ReadEmitterIntValue(tokens[read_token_count], &is_active) < 0)
-            goto read_error;
-
-        e->isActive = is_active;
-
-        if (ReadEmitterVector2(tokens[++read_token_count], &e->config.direction) < 0)
-            goto read_error;
-
-        if (ReadEmitterFloatRange(tokens[++read_token_count], &e->config.velocity) < 0)
-            goto read_error;
-
-        if (ReadEmitterFloatRange(tokens[++read_token_count], &e->config.directionAngle) < 0)
-            goto read_error;
-
-        if (ReadEmitterFloatRange(tokens[++read_token_count], &e->config.velocityAngle) < 0)
-            goto read_error;
-
-        if (ReadEmitterFloatRange(tokens[++read_token_count], &e->config.offset) < 0)
-            goto read_error;
-
-        if (ReadEmitterFloatRange(tokens[++read_token_count], &e->config.originAcceleration) < 0)
-            goto read_error;
-
-        if (ReadEmitterIntRange(tokens[++read_token_count], &e->config.burst) < 0)
-            goto read_error;
-
-        if (ReadEmitterIntValue(tokens[++read_token_count], (int *)&e->config.capacity) < 0)
-            goto read_error;
-
-        if (ReadEmitterVector2(tokens[++read_token_count], &e->config.origin) < 0)
-            goto read_error;
-
-        if (ReadEmitterVector2(tokens[++read_token_count], &e->config.externalAcceleration) < 0)
-            goto read_error;
-
-        if (ReadEmitterVector2(tokens[++read_token_count], &e->config.baseScale) < 0)
-            goto read_error;
-
-        if (ReadEmitterVector2(tokens[++read_token_count], &e->config.scaleIncrease) < 0)
-            goto read_error;
+        EmitterConfig cfg = loaded->emitters[i]->config;
+        const char *texture_path = NULL;
 
-        if (ReadEmitterColor(tokens[++read_token_count], &e->config.startColor) < 0)
-            goto read_error;
-
-        if (ReadEmitterColor(tokens[++read_token_count], &e->config.endColor) < 0)
-            goto read_error;
-
-        if (ReadEmitterFloatRange(tokens[++read_token_count], &e->config.age) < 0)
-            goto read_error;
-
-        if (ReadEmitterFloatValue(tokens[++read_token_count], &e->config.baseRotation) < 0)
-            goto read_error;
-
-        if (ReadEmitterFloatRange(tokens[++read_token_count], &e->config.rotationSpeed) < 0)
-            goto read_error;
+        for (int j = 0; j < state.count; j++)
+        {
+            if (state.textures[j].id != 0 && state.textures[j].id == cfg.texture.id)
+                texture_path = state.paths[j];
+        }
 
-        if (ReadEmitterVector2(tokens[++read_token_count], &e->config.textureOrigin) < 0)
-            goto read_error;
+        bool default_texture = !texture_path;
 
-        if (ReadEmitterString(tokens[++read_token_count], ec->texture_path) < 0)
-            goto read_error;
+        if (default_texture)
+        {
+            texture_path = "../particles/default.png";
+            cfg.texture = LoadTexture(texture_path);
+        }
 
-        memset(ec->metadata, 0, sizeof(ec->metadata));
+        // keep the old resources until the emitter no longer needs them
+        Texture2D old_texture = ec->emitter->config.texture;
 
-        if (ReadEmitterString(tokens[++read_token_count], ec->metadata) < 0)
+        if (!Emitter_Reinit(ec->emitter, cfg))
         {
-            printf("No metadata for emitter %d\n", i + 1);
+            if (default_texture)
+                UnloadTexture(cfg.texture);
+
+            res = false;
+            break;
         }
 
-        UnloadTexture(ec->emitter->config.texture);
+        UnloadTexture(old_texture);
         UnloadRenderTexture(ec->particle_editor_render_tex);
 
-        Texture2D tex = LoadTexture(ec->texture_path);
-
-        ec->emitter->config.texture = tex;
-        ec->particle_editor_render_tex = LoadRenderTexture(tex.width, tex.height);
-
-        i++;
+        snprintf(ec->texture_path, sizeof(ec->texture_path), "%s", texture_path);
+        ec->emitter->isActive = loaded->emitters[i]->isActive;
+        // the old metadata is kept if there is no memory for the new one
+        Emitter_SetMetadata(ec->emitter, loaded->emitters[i]->metadata);
+        ec->particle_editor_render_tex = LoadRenderTexture(cfg.texture.width, cfg.texture.height);
     }
 
-    fclose(f);
-    return true;
-
-read_error:
-    printf("Read error on emitter %d on token %d\n", i, read_token_count);
-    fclose(f);
-
-    return false;
-}
-
-static int WriteEmitterIntValue(char *str, size_t size, int val)
-{
-    char val_str[32] = {0};
-
-    int len = snprintf(val_str, sizeof(val_str), "%d|", val);
-
-    if (len > size)
-        return -1;
-
-    strncpy(str, val_str, size);
-
-    return len;
-}
-
-static int WriteEmitterFloatValue(char *str, size_t size, float val)
-{
-    char val_str[32] = {0};
-
-    int len = snprintf(val_str, sizeof(val_str), "%f|", val);
-
-    if (len > size)
-        return -1;
-
-    strncpy(str, val_str, size);
-
-    return len;
-}
-
-static int WriteEmitterFloatRange(char *str, size_t size, FloatRange val)
-{
-    char val_str[32] = {0};
-
-    int len = snprintf(val_str, sizeof(val_str), "%.03f,%.03f|", val.min, val.max);
-
-    if (len > size)
-        return -1;
-
-    strncpy(str, val_str, size);
-
-    return len;
-}
-
-static int WriteEmitterIntRange(char *str, size_t size, IntRange val)
-{
-    char val_str[32] = {0};
-
-    int len = snprintf(val_str, sizeof(val_str), "%d,%d|", val.min, val.max);
-
-    if (len > size)
-        return -1;
-
-    strncpy(str, val_str, size);
-
-    return len;
-}
-
-static int WriteEmitterVector2(char *str, size_t size, Vector2 val)
-{
-    char val_str[32] = {0};
-
-    int len = snprintf(val_str, sizeof(val_str), "%.03f,%.03f|", val.x, val.y);
-
-    if (len > size)
-        return -1;
-
-    strncpy(str, val_str, size);
-
-    return len;
-}
-
-static int WriteEmitterColor(char *str, size_t size, Color val)
-{
-    char val_str[32] = {0};
-
-    int len = snprintf(val_str, sizeof(val_str), "%d,%d,%d,%d|", val.r, val.g, val.b, val.a);
-
-    if (len > size)
-        return -1;
-
-    strncpy(str, val_str, size);
-
-    return len;
-}
-
-static int WriteEmitterString(char *str, size_t size, const char *to_write)
-{
-    if (strlen(to_write) > size)
-        return -1;
-
-    snprintf(str, strlen(to_write) + 1, "%s|", to_write);
-
-    return strlen(to_write) + 1;
-}
-
-static int ReadEmitterIntValue(char *str, int *val)
-{
-    int len = sscanf(str, "%d", val);
-
-    if (!len)
-        return -1;
-
-    return len;
-}
-
-static int ReadEmitterFloatValue(char *str, float *val)
-{
-    int len = sscanf(str, "%f", val);
-
-    if (!len)
-        return -1;
-
-    return len;
-}
-
-static int ReadEmitterFloatRange(char *str, FloatRange *val)
-{
-    int len = sscanf(str, "%f,%f", &val->min, &val->max);
-
-    if (!len)
-        return -1;
-
-    return len;
-}
-
-static int ReadEmitterIntRange(char *str, IntRange *val)
-{
-    int len = sscanf(str, "%d,%d", &val->min, &val->max);
-
-    if (!len)
-        return -1;
+    // textures of emitters past EMITTER_COUNT, or not reached after a failure, are not used
+    for (int j = 0; j < state.count; j++)
+    {
+        bool used = false;
 
-    return len;
-}
+        for (int i = 0; i < EMITTER_COUNT; i++)
+            used = used || emitters[i].emitter->config.texture.id == state.textures[j].id;
 
-static int ReadEmitterVector2(char *str, Vector2 *val)
-{
-    int len = sscanf(str, "%f,%f", &val->x, &val->y);
+        if (!used)
+            UnloadTexture(state.textures[j]);
+    }
 
-    if (!len)
-        return -1;
+    ParticleSystem_FreeAll(loaded);
 
-    return len;
+    return res;
 }
 
-static int ReadEmitterColor(char *str, Color *val)
+static Texture2D ResolveTexture(const char *path, void *user)
 {
-    int len = sscanf(str, "%hhu,%hhu,%hhu,%hhu", &val->r, &val->g, &val->b, &val->a);
+    ImportState *state = user;
 
-    if (!len)
-        return -1;
+    // the editor has a fixed amount of emitters, ignore the textures of extra ones
+    if (state->count >= EMITTER_COUNT)
+        return (Texture2D){0};
 
-    return len;
-}
+    snprintf(state->paths[state->count], sizeof(state->paths[state->count]), "%s", path);
+    state->textures[state->count] = LoadTexture(path);
 
-static int ReadEmitterString(char *str, char *read_str)
-{
-    int len = sscanf(str, "%s", read_str);
-
-    if (!len)
-        return -1;
-
-    return len;
+    return state->textures[state->count++];
 }
-
-static const char *GetExportCommentLine(void)
-{
-    return "# is active | direction | velocity | direction angle | velocity angle | offset | \
-origin acceleration | burst | capacity | origin | external acceleration | base scale | scale increase | \
-start color | end color | life time | base rotation | rotation speed | texture origin | texture path | metadata\n";
-}
\ No newline at end of file
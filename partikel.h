@@ -13,7 +13,8 @@
 *       - Supports all platforms that raylib supports
 *
 *   DEPENDENCIES:
-*       raylib >= v2.5.0 and all of its dependencies
+*       raylib >= v4.0.0 (including rlgl.h) and all of its dependencies,
+*       none with PARTIKEL_NO_RAYLIB
 *
 *   CONFIGURATION:
 *   #define LIBPARTIKEL_IMPLEMENTATION
@@ -21,6 +22,39 @@
 *       If not defined, the library is in header only mode and can be included in other headers
 *       or source files without problems. But only ONE file should hold the implementation.
 *
+*   #define PARTIKEL_NO_SIMD
+*       Disables the SSE2/AVX2 particle integration kernels. By default the widest kernel
+*       supported by the CPU is picked at runtime on x86 and x86-64 with GCC, Clang and MSVC.
+*
+*   #define PARTIKEL_INSTANCING
+*       Enables PARTICLE_DRAW_INSTANCED, which draws each Emitter with a single instanced
+*       draw call through rlgl. Needs an OpenGL 3.3 context at runtime, Emitters fall back
+*       to the default draw mode otherwise.
+*
+*   #define PARTIKEL_THREADS
+*       Enables ThreadPool, backed by pthreads. A ParticleSystem with a ThreadPool updates its
+*       Emitters in parallel, so particle_Deactivator functions must be thread safe.
+*       ParticleSimulation then updates its ParticleSystem on a worker thread while the
+*       previous ParticleSnapshot is drawn.
+*       Without it ThreadPool_New returns NULL and all updates run on the calling thread,
+*       and ParticleSystem_Post must be called on that thread as well. No C11 atomics
+*       are needed then.
+*
+*   #define PARTIKEL_NO_RAYLIB
+*       Builds the simulation only, e.g. for servers. Vector2, Color, Texture2D, BlendMode
+*       and DEG2RAD are defined by this header instead of raylib, all drawing functions
+*       are left out and random seeds come from rand() instead of GetRandomValue.
+*
+*   #define PARTIKEL_NO_INOTIFY
+*       EffectWatcher compares file modification times on every poll instead of
+*       using inotify on Linux.
+*
+*   #define PARTIKEL_CALLOC(count, size)
+*   #define PARTIKEL_REALLOC(ptr, size)
+*   #define PARTIKEL_FREE(ptr)
+*       Replace calloc, realloc and free for all memory allocated by the library.
+*       Define them before the implementation, all three or none.
+*
 *   LICENSE: zlib/libpng
 *
 *   libpartikel is licensed under an unmodified zlib/libpng license, which is an OSI-certified,
@@ -47,8 +81,62 @@
 
 #pragma once
 
+#include "stddef.h"
+#include "stdint.h"
+
+#ifdef PARTIKEL_NO_RAYLIB
+
+#include "stdbool.h"
+
+// The raylib types used by the simulation, with the same layout as in raylib.
+typedef struct Vector2 {
+    float x;
+    float y;
+} Vector2;
+
+typedef struct Color {
+    unsigned char r;
+    unsigned char g;
+    unsigned char b;
+    unsigned char a;
+} Color;
+
+typedef struct Texture {
+    unsigned int id;
+    int width;
+    int height;
+    int mipmaps;
+    int format;
+} Texture;
+
+typedef Texture Texture2D;
+
+typedef enum {
+    BLEND_ALPHA = 0,
+    BLEND_ADDITIVE,
+    BLEND_MULTIPLIED,
+    BLEND_ADD_COLORS,
+    BLEND_SUBTRACT_COLORS,
+    BLEND_ALPHA_PREMULTIPLY,
+    BLEND_CUSTOM
+} BlendMode;
+
+#ifndef PI
+#define PI 3.14159265358979323846f
+#endif
+#ifndef DEG2RAD
+#define DEG2RAD (PI/180.0f)
+#endif
+
+// Instancing needs rlgl.
+#undef PARTIKEL_INSTANCING
+
+#else
+
 #include "raylib.h"
 
+#endif // PARTIKEL_NO_RAYLIB
+
 /**  TODOs
  *
  * 0) MAYBE switch to purely function pointer based system.. handle Init, Update, Draw etc.
@@ -75,12 +163,65 @@ typedef struct IntRange {
     int max;
 } IntRange;
 
+// Random is the state of a small PCG32 random number generator.
+// Every Emitter owns one, so its particles can be reproduced from a seed.
+typedef struct Random {
+    uint64_t state;
+    uint64_t inc;
+} Random;
+
+// Maximum amount of keys in a curve.
+#define PARTIKEL_MAX_KEYS 8
+
+// FloatKey is a value at a point in the life of a particle.
+typedef struct FloatKey {
+    float time;                     // Normalized age (age / ttl) between 0 and 1.
+    float value;
+} FloatKey;
+
+// ColorKey is a color at a point in the life of a particle.
+typedef struct ColorKey {
+    float time;                     // Normalized age (age / ttl) between 0 and 1.
+    Color color;
+} ColorKey;
+
+// FloatCurve describes a value over the life of a particle. Keys must be sorted by time,
+// values between keys are interpolated linearly. A curve without keys is unused.
+typedef struct FloatCurve {
+    unsigned int count;
+    FloatKey keys[PARTIKEL_MAX_KEYS];
+} FloatCurve;
+
+// ColorCurve describes a color gradient over the life of a particle, see FloatCurve.
+typedef struct ColorCurve {
+    unsigned int count;
+    ColorKey keys[PARTIKEL_MAX_KEYS];
+} ColorCurve;
+
+// ParticleDrawMode selects how Emitter_Draw draws the particles of an Emitter.
+typedef enum ParticleDrawMode {
+    PARTICLE_DRAW_DEFAULT = 0,      // Call particle_Draw for every particle. If particle_Draw is
+                                    // NULL, draw textured quads in batches like DrawTexturePro.
+    PARTICLE_DRAW_INSTANCED         // One instanced draw call per Emitter, see PARTIKEL_INSTANCING.
+} ParticleDrawMode;
+
+// ParticleMotion selects how the particles of an Emitter move, see EmitterConfig_IsBallistic.
+typedef enum ParticleMotion {
+    PARTICLE_MOTION_INTEGRATED = 0, // Integrate velocity, position, scale and rotation every update.
+    PARTICLE_MOTION_BALLISTIC       // Keep the spawn state and evaluate it at the particle's age.
+} ParticleMotion;
+
 // Needed forward declarations.
 //----------------------------------------------------------------------------------
 typedef struct Particle Particle;
 typedef struct EmitterConfig EmitterConfig;
 typedef struct Emitter Emitter;
 typedef struct ParticleSystem ParticleSystem;
+typedef struct ThreadPool ThreadPool;
+typedef struct ParticleSimulation ParticleSimulation;
+typedef struct CommandQueue CommandQueue;
+typedef struct EffectRegistry EffectRegistry;
+typedef struct EffectWatcher EffectWatcher;
 
 // EmitterConfig type.
 //----------------------------------------------------------------------------------
@@ -102,17 +243,27 @@ struct EmitterConfig {
     Vector2 scaleIncrease;          // Scale increase on both X & Y
     Color startColor;               // The color the particle starts with when it spawns.
     Color endColor;                 // The color the particle ends with when it disappears.
+    ColorCurve colorOverLife;       // Replaces startColor and endColor if it has keys.
+    FloatCurve alphaOverLife;       // Multiplies the alpha of the color (0 to 1) if it has keys.
+    FloatCurve scaleOverLife;       // Multiplies the drawn scale of particles if it has keys.
+    FloatCurve dampingOverLife;     // Fraction of velocity lost per second if it has keys.
     FloatRange age;                 // Age range of particles in seconds.
     BlendMode blendMode;            // Color blending mode for all particles of this Emitter.
     FloatRange rotationSpeed;       // Speed rotation of particles
     Texture2D texture;              // The texture used as particle texture.    
     Vector2 textureOrigin;          // Origin of the particle's texture
+    ParticleDrawMode drawMode;      // How particles are drawn.
+    ParticleMotion motion;          // How particles move.
+    unsigned int seed;              // Seed of the Emitter's random generator.
+                                    // 0 picks a random seed using raylib's GetRandomValue,
+                                    // or rand() with PARTIKEL_NO_RAYLIB.
     void *user_data;                // User data
 
     bool (*particle_Deactivator)(Particle *);   // Pointer to a function that determines when
                                                 // a particle is deactivated.
 
-    void (*particle_Draw)(Emitter *e, Particle *p); // Pointer to a function that draw a single particle
+    void (*particle_Draw)(Emitter *e, Particle *p); // Pointer to a function that draw a single particle.
+                                                    // May be NULL to use the built-in renderer.
 
 };
 
@@ -138,22 +289,132 @@ struct Particle {
                                                      // when a particle is deactivated.
 };
 
+// ParticleArrays type.
+//----------------------------------------------------------------------------------
+
+// Alignment in bytes of every array in ParticleArrays. A cache line on all common
+// targets and wide enough for any SIMD load.
+#define PARTIKEL_ALIGNMENT 64
+#define PARTIKEL_ALIGN_UP(n) (((n) + PARTIKEL_ALIGNMENT - 1) & ~(size_t)(PARTIKEL_ALIGNMENT - 1))
+
+// ParticleArrays holds the state of all particles of an Emitter as a structure of arrays.
+// Every array is contiguous, aligned to PARTIKEL_ALIGNMENT and can hold capacity particles.
+// The particle at index i is made of the i-th element of every array.
+// Live particles are kept packed at [0, length). A dying particle is replaced by the
+// last live one, so the order of particles is not stable. The free slots are always
+// [length, capacity), which makes finding room for n new particles O(1).
+typedef struct ParticleArrays {
+    float *originX;             // The origin of the particle (never changes).
+    float *originY;
+    float *positionX;           // Position of the particle in 2d space.
+    float *positionY;
+    float *velocityX;           // Velocity vector in 2d space.
+    float *velocityY;
+    float *scaleX;              // Scale of the particle (both X & Y)
+    float *scaleY;
+    float *rotation;            // Particle's current rotation
+    float *rotationSpeed;       // Particle's rotation speed
+    float *originAcceleration;  // Accelerates velocity vector
+    float *age;                 // Age is measured in seconds.
+    float *ttl;                 // Ttl is the time to live in seconds.
+    float *invTtl;              // 1 / ttl, 0 if ttl is 0.
+    unsigned int length;        // Amount of live particles.
+    unsigned int capacity;      // Amount of particles the arrays can hold.
+    void *block;                // The allocation backing all arrays, NULL if not owned.
+} ParticleArrays;
+
+// SimdLevel selects the kernel used to integrate particles.
+// The SIMD kernels normalize the direction to the origin with a reciprocal square root
+// estimate refined by one Newton-Raphson step, and multiply it out in a different order
+// (dx * (rs * originAcceleration * dt) instead of (dx * rs) * originAcceleration * dt).
+// The origin acceleration differs from the scalar kernel by a relative error of at most
+// 1e-6 per step, so velocity and position differ in their last bits and drift apart over
+// many steps. Scale and rotation are computed exactly like the scalar kernel does.
+// Simulations, and so rollback with Emitter_Snapshot, are only reproducible bit for bit
+// on the same SimdLevel.
+typedef enum SimdLevel {
+    SIMD_SCALAR = 0,
+    SIMD_SSE2,
+    SIMD_AVX2
+} SimdLevel;
+
+// Amount of entries in every ParticleLUT table.
+#define PARTIKEL_LUT_SIZE 256
+
+// ParticleLUT holds properties over the life of a particle, sampled at PARTIKEL_LUT_SIZE
+// evenly spaced points of its normalized age (age / ttl). It is baked from an EmitterConfig,
+// so sampling costs the same no matter how many keys the curves have.
+typedef struct ParticleLUT {
+    Color color[PARTIKEL_LUT_SIZE];
+    float scale[PARTIKEL_LUT_SIZE];
+    float damping[PARTIKEL_LUT_SIZE];
+    bool hasScale;                  // False if scale is 1 everywhere.
+    bool hasDamping;                // False if damping is 0 everywhere.
+} ParticleLUT;
+
+// ParticleInstance is the per particle data uploaded for instanced drawing.
+typedef struct ParticleInstance {
+    float x;
+    float y;
+    float scaleX;
+    float scaleY;
+    float rotation;
+    Color color;
+} ParticleInstance;
+
+// ParticleInstances holds the buffers used to draw an Emitter with PARTICLE_DRAW_INSTANCED.
+// They are created on first use and grow with the amount of live particles.
+typedef struct ParticleInstances {
+    ParticleInstance *data;     // CPU side copy of the instance buffer.
+    unsigned int capacity;      // Amount of instances both buffers can hold.
+    unsigned int vao;           // Vertex array, quad buffer and instance buffer ids.
+    unsigned int quadVbo;
+    unsigned int instanceVbo;
+} ParticleInstances;
+
 // Emitter type.
 //----------------------------------------------------------------------------------
 
 // Emitter is a single (point) source emitting many particles.
+// An Emitter and its particles live in one cache line aligned allocation.
 struct Emitter {
     EmitterConfig config;
     float mustEmit;             // Amount of particles to be emitted within next update call.
     Vector2 offset;             // Offset holds half the width and height of the texture.
     bool isEmitting;
     bool isActive;              // Will spawn particles or not
-    Particle **particles;       // Array of all particles (by pointer).
+    Random random;              // Random generator used for all particles of this Emitter.
+    ParticleArrays particles;   // State of all particles.
+    ParticleLUT *lut;           // Properties over life baked from config.
+    bool sharesLUT;             // lut belongs to an EffectTemplate and is never baked into.
+    void *lutBlock;             // Own ParticleLUT once a shared one had to be rebaked, or NULL.
+    float renderLag;            // Seconds the drawn particles lag behind the simulated ones,
+                                // see ParticleSystem_SetFixedStep.
+    ParticleInstances instances; // Buffers for PARTICLE_DRAW_INSTANCED.
+    char *metadata;             // Text saved along in text effects, see Emitter_SetMetadata, or NULL.
+    void *block;                // The allocation holding the Emitter and its initial particles.
+    void *blockParticles;       // Particle storage within block, see Emitter_Reinit.
+    unsigned int blockCapacity; // Amount of particles blockParticles can hold.
 };
 
 // ParticleSystem type.
 //----------------------------------------------------------------------------------
 
+// ParticleCommandType lists the operations which can be posted to a ParticleSystem.
+typedef enum ParticleCommandType {
+    PARTICLE_COMMAND_BURST = 0,
+    PARTICLE_COMMAND_SET_ORIGIN,
+    PARTICLE_COMMAND_START,
+    PARTICLE_COMMAND_STOP
+} ParticleCommandType;
+
+// ParticleCommand is an operation run by ParticleSystem_Update on behalf of another thread.
+typedef struct ParticleCommand {
+    ParticleCommandType type;
+    Emitter *emitter;           // Emitter to run the command on, NULL for the whole system.
+    Vector2 origin;             // New origin for PARTICLE_COMMAND_SET_ORIGIN.
+} ParticleCommand;
+
 // ParticleSystem is a set of emitters grouped logically
 // together to achieve a specific visual effect.
 // While Emitters can be used independently, ParticleSystem
@@ -164,31 +425,130 @@ struct ParticleSystem {
     unsigned int capacity;
     Vector2 origin;
     Emitter **emitters;
+    ThreadPool *pool;           // Pool used to update Emitters in parallel, may be NULL.
+    CommandQueue *commands;     // Commands posted from other threads, may be NULL.
+    Emitter **order;            // Emitters sorted by work, scratch space for parallel updates.
+    unsigned long *counts;      // Live particles per entry of order.
+    unsigned int orderCapacity;
+    float fixedStep;            // Seconds per simulation step, 0 to step with every update.
+    float accumulator;          // Time not simulated yet in fixed step mode.
 };
 
+// ParticleSnapshot type.
+//----------------------------------------------------------------------------------
+
+// SnapshotEmitter is the part of a ParticleSnapshot captured from one Emitter.
+typedef struct SnapshotEmitter {
+    Emitter *emitter;           // Only texture, blend and draw mode are read while drawing.
+    unsigned int first;         // Index of the first particle in ParticleSnapshot.particles.
+    unsigned int count;
+} SnapshotEmitter;
+
+// ParticleSnapshot is an immutable copy of everything needed to draw a ParticleSystem,
+// so it can be drawn while the system is updated on another thread.
+typedef struct ParticleSnapshot {
+    ParticleInstance *particles;
+    unsigned int length;
+    unsigned int capacity;
+    SnapshotEmitter *emitters;
+    unsigned int emitterLength;
+    unsigned int emitterCapacity;
+} ParticleSnapshot;
+
+// Effect files.
+//----------------------------------------------------------------------------------
+
+// TextureResolver returns the texture stored under path in an effect file,
+// e.g. by calling LoadTexture. Textures are owned by the caller, also those resolved
+// by a load that fails afterwards: record them in user to release them in either case.
+typedef Texture2D (*TextureResolver)(const char *path, void *user);
+
+// TextureReleaser gives back a texture returned by a TextureResolver, e.g. by calling UnloadTexture.
+typedef void (*TextureReleaser)(Texture2D texture, void *user);
+
+// EffectTemplate is an effect prepared once to be instantiated many times, see
+// ParticleSystem_Instantiate. All instances read its ParticleLUTs and share its textures,
+// only particle state is allocated per instance. A template must outlive its instances.
+typedef struct EffectTemplate {
+    unsigned int length;        // Amount of Emitters.
+    EmitterConfig *configs;
+    bool *isActive;
+    ParticleLUT *luts;          // Baked from configs.
+    unsigned int instances;     // Amount of instances created so far, mixed into their seeds.
+    void *block;                // The allocation holding the template, configs and ParticleLUTs.
+} EffectTemplate;
+
 // Function signatures (comments are found in implementation below)
 //----------------------------------------------------------------------------------
 float GetRandomFloat(float min, float max);
+void Random_Seed(Random *r, uint64_t seed);
+uint32_t Random_Next(Random *r);
+float Random_Float(Random *r, float min, float max);
+int Random_Int(Random *r, int min, int max);
 Vector2 NormalizeV2(Vector2 v);
 Vector2 RotateV2(Vector2 v, float degrees);
+void SinCosDegrees(const float *degrees, float *sines, float *cosines, unsigned int n);
 Color LinearFade(Color c1, Color c2, float fraction);
 
 bool Particle_DeactivatorAge(Particle *p);
 Particle * Particle_New(bool (*deactivatorFunc)(struct Particle *));
 void Particle_Free(Particle *p);
 void Particle_Init(Particle *p, EmitterConfig *cfg);
+void Particle_InitRandom(Particle *p, EmitterConfig *cfg, Random *r);
 void Particle_Update(Particle *p, float dt);
 
+size_t ParticleArrays_Size(unsigned int capacity);
+void ParticleArrays_Place(ParticleArrays *pa, unsigned int capacity, void *memory);
+bool ParticleArrays_Alloc(ParticleArrays *pa, unsigned int capacity);
+void ParticleArrays_Free(ParticleArrays *pa);
+void ParticleArrays_Move(ParticleArrays *dst, unsigned int to, ParticleArrays *src, unsigned int from);
+Particle ParticleArrays_Get(ParticleArrays *pa, EmitterConfig *cfg, unsigned int i);
+void ParticleArrays_Init(ParticleArrays *pa, unsigned int i, EmitterConfig *cfg, Random *r);
+unsigned int ParticleArrays_LUTIndex(ParticleArrays *pa, unsigned int i);
+
+float FloatCurve_Evaluate(FloatCurve *curve, float time, float fallback);
+Color ColorCurve_Evaluate(ColorCurve *curve, float time, Color fallback);
+void ParticleLUT_Bake(ParticleLUT *lut, EmitterConfig *cfg);
+void ParticleArrays_Damp(ParticleArrays *pa, ParticleLUT *lut, unsigned int begin, unsigned int end, float dt);
+unsigned int ParticleArrays_ExpireRange(ParticleArrays *pa, EmitterConfig *cfg, unsigned int begin, unsigned int end, float dt);
+unsigned long ParticleArrays_Expire(ParticleArrays *pa, EmitterConfig *cfg, float dt);
+unsigned long ParticleArrays_Compact(ParticleArrays *pa, unsigned int chunkSize, const unsigned int *live, unsigned int chunks);
+void ParticleArrays_Integrate(ParticleArrays *pa, EmitterConfig *cfg, unsigned int begin, unsigned int end, float dt);
+bool EmitterConfig_IsBallistic(EmitterConfig *cfg);
+void ParticleArrays_SetBallistic(ParticleArrays *pa, EmitterConfig *cfg, bool ballistic);
+unsigned long ParticleArrays_Update(ParticleArrays *pa, EmitterConfig *cfg, float dt);
+SimdLevel ParticleArrays_GetSimdLevel(void);
+SimdLevel ParticleArrays_SetSimdLevel(SimdLevel level);
+unsigned int ParticleArrays_Spawn(ParticleArrays *pa, EmitterConfig *cfg, Random *r, unsigned int n);
+
 Emitter * Emitter_New(EmitterConfig cfg);
 bool Emitter_Reinit(Emitter *e, EmitterConfig cfg);
 void Emitter_Start(Emitter *e);
 void Emitter_Stop(Emitter *e);
 void Emitter_Free(Emitter *e);
 void Emitter_Burst(Emitter *e);
+unsigned int Emitter_SpawnBatch(Emitter *e, unsigned int n);
+unsigned int Emitter_Emit(Emitter *e, float dt);
+unsigned long Emitter_Simulate(Emitter *e, float dt);
 unsigned long Emitter_Update(Emitter *e, float dt);
+unsigned long Emitter_UpdateParallel(Emitter *e, ThreadPool *pool, float dt);
+unsigned long Emitter_Prewarm(Emitter *e, float seconds);
+unsigned int Emitter_LiveCount(Emitter *e);
+bool Emitter_BakeLUT(Emitter *e);
+Color Emitter_GetParticleColor(Emitter *e, Particle *p);
+size_t Emitter_Snapshot(Emitter *e, void *buffer, size_t size);
+size_t Emitter_Restore(Emitter *e, const void *buffer, size_t size);
+#ifndef PARTIKEL_NO_RAYLIB
 void Emitter_Draw(Emitter *e);
+void UnloadInstancedShader(void);
+#endif
+
+ThreadPool * ThreadPool_New(unsigned int threads);
+void ThreadPool_Run(ThreadPool *pool, unsigned int count, void (*task)(void *ctx, unsigned int index), void *ctx);
+void ThreadPool_Free(ThreadPool *pool);
 
 ParticleSystem * ParticleSystem_New(void);
+void ParticleSystem_SetThreadPool(ParticleSystem *ps, ThreadPool *pool);
 bool ParticleSystem_Register(ParticleSystem *ps, Emitter *emitter);
 bool ParticleSystem_Deregister(ParticleSystem *ps, Emitter *emitter);
 void ParticleSystem_SetOrigin(ParticleSystem *ps, Vector2 origin);
@@ -197,15 +557,79 @@ void ParticleSystem_SetBaseRotation(ParticleSystem *ps, float rotation);
 void ParticleSystem_Start(ParticleSystem *ps);
 void ParticleSystem_Stop(ParticleSystem *ps);
 void ParticleSystem_Burst(ParticleSystem *ps);
+#ifndef PARTIKEL_NO_RAYLIB
 void ParticleSystem_Draw(ParticleSystem *ps);
+#endif
 unsigned long ParticleSystem_Update(ParticleSystem *ps, float dt);
+void ParticleSystem_SetFixedStep(ParticleSystem *ps, float step);
+unsigned long ParticleSystem_Prewarm(ParticleSystem *ps, float seconds);
+unsigned long ParticleSystem_LiveCount(ParticleSystem *ps);
 void ParticleSystem_Free(ParticleSystem *p);
+void ParticleSystem_FreeAll(ParticleSystem *ps);
+bool ParticleSystem_EnableCommands(ParticleSystem *ps, unsigned int capacity);
+bool ParticleSystem_Post(ParticleSystem *ps, ParticleCommand command);
+unsigned int ParticleSystem_RunCommands(ParticleSystem *ps);
+size_t ParticleSystem_Snapshot(ParticleSystem *ps, void *buffer, size_t size);
+bool ParticleSystem_Restore(ParticleSystem *ps, const void *buffer, size_t size);
+
+bool ParticleSnapshot_Capture(ParticleSnapshot *s, ParticleSystem *ps);
+#ifndef PARTIKEL_NO_RAYLIB
+void ParticleSnapshot_Draw(ParticleSnapshot *s);
+#endif
+void ParticleSnapshot_Free(ParticleSnapshot *s);
+
+ParticleSimulation * ParticleSimulation_New(ParticleSystem *ps);
+ParticleSnapshot * ParticleSimulation_Swap(ParticleSimulation *sim, float dt);
+void ParticleSimulation_Free(ParticleSimulation *sim);
+
+ParticleSystem * ParticleSystem_LoadBinary(const void *data, size_t size, TextureResolver resolve, void *user);
+ParticleSystem * ParticleSystem_LoadBinaryFile(const char *path, TextureResolver resolve, void *user);
+size_t ParticleSystem_SaveBinary(ParticleSystem *ps, const char *const *texturePaths, void *buffer, size_t size);
+bool ParticleSystem_SaveBinaryFile(ParticleSystem *ps, const char *const *texturePaths, const char *path);
+ParticleSystem * ParticleSystem_LoadFromMemory(const char *text, size_t size, TextureResolver resolve, void *user);
+ParticleSystem * ParticleSystem_LoadFromFile(const char *path, TextureResolver resolve, void *user);
+size_t ParticleSystem_Save(ParticleSystem *ps, const char *const *texturePaths, char *buffer, size_t size);
+bool ParticleSystem_SaveToFile(ParticleSystem *ps, const char *const *texturePaths, const char *path);
+bool Emitter_SetMetadata(Emitter *e, const char *metadata);
+
+EffectTemplate * EffectTemplate_New(ParticleSystem *ps);
+void EffectTemplate_Free(EffectTemplate *t);
+ParticleSystem * ParticleSystem_Instantiate(EffectTemplate *t, Vector2 origin);
+EffectRegistry * EffectRegistry_New(TextureResolver resolve, TextureReleaser release, void *user);
+EffectTemplate * EffectRegistry_Load(EffectRegistry *r, const char *path);
+Texture2D EffectRegistry_GetTexture(EffectRegistry *r, const char *path);
+void EffectRegistry_Free(EffectRegistry *r);
+EffectWatcher * EffectWatcher_New(TextureResolver resolve, TextureReleaser release, void *user);
+bool EffectWatcher_Watch(EffectWatcher *w, ParticleSystem *ps, const char *path);
+unsigned int EffectWatcher_Poll(EffectWatcher *w);
+void EffectWatcher_Free(EffectWatcher *w);
 
 
 #ifdef LIBPARTIKEL_IMPLEMENTATION
 
 #include "stdlib.h"
 #include "math.h"
+#include "string.h"
+#ifndef PARTIKEL_NO_RAYLIB
+#include "rlgl.h"
+#endif
+
+// RandomValue returns a random int between 0 and RAND_MAX.
+#ifdef PARTIKEL_NO_RAYLIB
+#define RandomValue() rand()
+#else
+#define RandomValue() GetRandomValue(0, RAND_MAX)
+#endif
+
+#ifndef PARTIKEL_CALLOC
+#define PARTIKEL_CALLOC(count, size) calloc(count, size)
+#endif
+#ifndef PARTIKEL_REALLOC
+#define PARTIKEL_REALLOC(ptr, size) realloc(ptr, size)
+#endif
+#ifndef PARTIKEL_FREE
+#define PARTIKEL_FREE(ptr) free(ptr)
+#endif
 
 // Utility functions & structs.
 //----------------------------------------------------------------------------------
@@ -213,10 +637,50 @@ void ParticleSystem_Free(ParticleSystem *p);
 // GetRandomFloat returns a random float between 0.0 and 1.0.
 float GetRandomFloat(float min, float max) {
     float range = max - min;
-    float n = (float) GetRandomValue(0, RAND_MAX) / (float) RAND_MAX;
+    float n = (float) RandomValue() / (float) RAND_MAX;
     return n*range + min;
 }
 
+// Random_Seed resets the generator to the sequence defined by seed.
+void Random_Seed(Random *r, uint64_t seed) {
+    r->state = 0;
+    r->inc = (seed << 1u) | 1u;
+    Random_Next(r);
+    r->state += seed ^ 0x853c49e6748fea9bULL;
+    Random_Next(r);
+}
+
+// Random_Next returns the next 32 random bits.
+uint32_t Random_Next(Random *r) {
+    uint64_t old = r->state;
+    r->state = old * 6364136223846793005ULL + r->inc;
+    uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = (uint32_t)(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+// Random_Float returns a random float between min and max.
+float Random_Float(Random *r, float min, float max) {
+    float n = (float)(Random_Next(r) >> 8) * (1.0f / 16777216.0f);
+    return n*(max - min) + min;
+}
+
+// Random_Int returns a random int between min and max, both included.
+int Random_Int(Random *r, int min, int max) {
+    if(min > max) {
+        int tmp = max;
+        max = min;
+        min = tmp;
+    }
+    uint64_t range = (uint64_t)((int64_t)max - min) + 1;
+    return (int)((int64_t)min + (int64_t)(((uint64_t)Random_Next(r) * range) >> 32));
+}
+
+// RandomFloat draws from r, or from raylib's generator if r is NULL.
+static float RandomFloat(Random *r, float min, float max) {
+    return r != NULL ? Random_Float(r, min, max) : GetRandomFloat(min, max);
+}
+
 // NormalizeV2 normalizes a 2d Vector and returns its unit vector.
 Vector2 NormalizeV2(Vector2 v) {
     if(v.x == 0 && v.y == 0){
@@ -235,6 +699,33 @@ Vector2 RotateV2(Vector2 v, float degrees) {
     return res;
 }
 
+// SinCosDegrees computes sine and cosine of n angles given in degrees.
+// The loop is free of calls and branches so compilers can vectorize it.
+// The absolute error is below 1e-6 for angles within +-360 degrees and grows
+// with the magnitude of the angle. Angles must be within +-90000 degrees.
+void SinCosDegrees(const float *degrees, float *sines, float *cosines, unsigned int n) {
+    for(unsigned int i = 0; i < n; i++) {
+        float x = degrees[i] * DEG2RAD;
+
+        // Reduce x to r in [-pi/4, pi/4] and the quadrant q, x = q*pi/2 + r.
+        // The bias makes the truncating conversion round to nearest.
+        int q = (int)(x * 0.63661977236f + 1024.5f) - 1024;
+        float fq = (float)q;
+        float r = ((x - fq * 1.5703125f) - fq * 4.8375129699707031e-4f) - fq * 7.5497899548918821e-8f;
+        float r2 = r * r;
+
+        float sr = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+        float cr = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+        // Rotate the result into the right quadrant.
+        float swap = (float)(q & 1);
+        float sinSign = 1.0f - (float)(q & 2);
+        float cosSign = 1.0f - (float)((q + 1) & 2);
+        sines[i] = (sr + swap * (cr - sr)) * sinSign;
+        cosines[i] = (cr + swap * (sr - cr)) * cosSign;
+    }
+}
+
 
 // LinearFade fades from Color c1 to Color c2. Fraction is a value between 0 and 1.
 // The interpolation is linear.
@@ -263,7 +754,7 @@ bool Particle_DeactivatorAge(Particle *p) {
 // Particle_new creates a new Particle object.
 // The deactivator function may be omitted by passing NULL.
 Particle * Particle_New(bool (*deactivatorFunc)(struct Particle *)) {
-    Particle *p = calloc(1, sizeof(Particle));
+    Particle *p = PARTIKEL_CALLOC(1, sizeof(Particle));
     if(p == NULL) {
         return NULL;
     }
@@ -289,34 +780,40 @@ Particle * Particle_New(bool (*deactivatorFunc)(struct Particle *)) {
 
 // Particle_free frees all memory used by the Particle.
 void Particle_Free(Particle *p) {
-    free(p);
+    PARTIKEL_FREE(p);
 }
 
 // Particle_Init inits a particle. It is then ready to be updated and drawn.
-void Particle_Init(Particle *p, EmitterConfig *cfg) {  
+// Random values are taken from raylib's generator.
+void Particle_Init(Particle *p, EmitterConfig *cfg) {
+    Particle_InitRandom(p, cfg, NULL);
+}
+
+// Particle_InitRandom inits a particle drawing all random values from r.
+void Particle_InitRandom(Particle *p, EmitterConfig *cfg, Random *r) {
     p->age = 0;
     p->origin = cfg->origin;
 
     // Get a random angle to find an random velocity.
-    float randa = GetRandomFloat(cfg->directionAngle.min, cfg->directionAngle.max);
+    float randa = RandomFloat(r, cfg->directionAngle.min, cfg->directionAngle.max);
 
     // Rotate base direction with the given angle.
     Vector2 res = RotateV2(cfg->direction, randa);
 
     // Get a random value for velocity range (direction is normalized).
-    float randv = GetRandomFloat(cfg->velocity.min, cfg->velocity.max);
+    float randv = RandomFloat(r, cfg->velocity.min, cfg->velocity.max);
 
     // Multiply direction with factor to set actual velocity in the Particle.
     p->velocity = (Vector2){.x = res.x * randv, .y = res.y * randv};
 
     // Get a random angle to rotate the velocity vector.
-    randa = GetRandomFloat(cfg->velocityAngle.min, cfg->velocityAngle.max);
+    randa = RandomFloat(r, cfg->velocityAngle.min, cfg->velocityAngle.max);
 
     // Rotate velocity vector with given angle.
     p->velocity = RotateV2(p->velocity, randa);
 
     // Get a random value for origin offset and apply it to position.
-    float rando = GetRandomFloat(cfg->offset.min, cfg->offset.max);
+    float rando = RandomFloat(r, cfg->offset.min, cfg->offset.max);
     p->position.x = cfg->origin.x + res.x * rando;
     p->position.y = cfg->origin.y + res.y * rando;
 
@@ -325,17 +822,17 @@ void Particle_Init(Particle *p, EmitterConfig *cfg) {
     p->scaleIncrease = cfg->scaleIncrease;
 
     // Get a random value for the intrinsic particle acceleration
-    float rands = GetRandomFloat(cfg->originAcceleration.min, cfg->originAcceleration.max);
+    float rands = RandomFloat(r, cfg->originAcceleration.min, cfg->originAcceleration.max);
     p->originAcceleration = rands;
     p->externalAcceleration = cfg->externalAcceleration;
-    p->ttl = GetRandomFloat(cfg->age.min, cfg->age.max);
+    p->ttl = RandomFloat(r, cfg->age.min, cfg->age.max);
     p->active = true;
 
     // Set initial rotation
     p->rotation = cfg->baseRotation;
 
     // Get a random rotation speed
-    p->rotationSpeed = GetRandomFloat(cfg->rotationSpeed.min, cfg->rotationSpeed.max);
+    p->rotationSpeed = RandomFloat(r, cfg->rotationSpeed.min, cfg->rotationSpeed.max);
 }
 
 // Particle_update updates all properties according to the delta time (in seconds).
@@ -382,283 +879,4298 @@ void Particle_Update(Particle *p, float dt) {
         p->rotation -= 360.0f;
 }
 
-// Emitter_New creates a new Emitter object.
-Emitter * Emitter_New(EmitterConfig cfg) {
-    Emitter *e = calloc(1, sizeof(Emitter));
-    if(e == NULL) {
-        return NULL;
-    }
-    e->config = cfg;
-    e->offset.x = 0;
-    e->offset.y = 0;
-    e->isActive = true;
-    e->particles = calloc(e->config.capacity, sizeof(Particle *));
-    if(e->particles == NULL) {
-        free(e);
-        return NULL;
-    }
-    e->mustEmit = 0;
-    // Normalize direction for future uses.
-    e->config.direction = NormalizeV2(e->config.direction);
+// PARTIKEL_FLOAT_ARRAYS is the amount of float arrays in ParticleArrays.
+#define PARTIKEL_FLOAT_ARRAYS 14
 
-    for(unsigned int i = 0; i < e->config.capacity; i++) {
-        e->particles[i] = Particle_New(e->config.particle_Deactivator);
-    }
+// AlignPointer returns the first address at or after ptr aligned to PARTIKEL_ALIGNMENT.
+static void * AlignPointer(void *ptr) {
+    return (void *)PARTIKEL_ALIGN_UP((uintptr_t)ptr);
+}
 
-    return e;
+// ParticleArrays_Size returns the amount of bytes needed to hold
+// all arrays for capacity particles, not counting alignment slack.
+size_t ParticleArrays_Size(unsigned int capacity) {
+    return PARTIKEL_FLOAT_ARRAYS * PARTIKEL_ALIGN_UP((size_t)capacity * sizeof(float));
 }
 
-// Emitter_Reinit reinits the given Emitter with a new EmitterConfig.
-bool Emitter_Reinit(Emitter *e, EmitterConfig cfg) {
-    if(cfg.capacity > e->config.capacity) {
-        // Array needs to be grown to the new size.
-        Particle **newParticles = realloc(e->particles, cfg.capacity * sizeof(Particle *));
-        if(newParticles == NULL) {
-            return false;
-        }
-        e->particles = newParticles;
+// ParticleArrays_Place lays out the arrays for capacity particles in the given memory.
+// The memory must be zeroed, aligned to PARTIKEL_ALIGNMENT and at least
+// ParticleArrays_Size(capacity) bytes long. It is not owned by the ParticleArrays.
+void ParticleArrays_Place(ParticleArrays *pa, unsigned int capacity, void *memory) {
+    size_t stride = PARTIKEL_ALIGN_UP((size_t)capacity * sizeof(float));
+    unsigned char *cursor = memory;
 
-        // Create new Particles
-        for(unsigned int i = e->config.capacity; i < cfg.capacity; i++) {
-            e->particles[i] = Particle_New(cfg.particle_Deactivator);
-        }
-    } else if(cfg.capacity < e->config.capacity) {
-        // First we free the now obsolete Particles.
-        for(unsigned int i = cfg.capacity; i < e->config.capacity; i++) {
-            Particle_Free(e->particles[i]);
-        }
+    *pa = (ParticleArrays){0};
+    pa->capacity = capacity;
 
-        // Array needs to be shrunk to the new size.
-        Particle **newParticles = realloc(e->particles, cfg.capacity * sizeof(Particle *));
-        if(newParticles == NULL) {
-            return false;
-        }
-        e->particles = newParticles;
+    float **arrays[PARTIKEL_FLOAT_ARRAYS] = {
+        &pa->originX, &pa->originY, &pa->positionX, &pa->positionY,
+        &pa->velocityX, &pa->velocityY, &pa->scaleX, &pa->scaleY,
+        &pa->rotation, &pa->rotationSpeed, &pa->originAcceleration, &pa->age, &pa->ttl,
+        &pa->invTtl
+    };
+    for(unsigned int i = 0; i < PARTIKEL_FLOAT_ARRAYS; i++) {
+        *arrays[i] = (float *)cursor;
+        cursor += stride;
     }
+}
 
-    // Set new config.
-    e->config = cfg;
-
-    // Set new Particle deactivator function for all Particles.
-    for(unsigned int i = 0; i < e->config.capacity; i++) {
-        e->particles[i]->particle_Deactivator = e->config.particle_Deactivator;
+// ParticleArrays_Alloc allocates all arrays for capacity particles in one block.
+// There are no live particles initially. Returns true on success and false otherwise.
+bool ParticleArrays_Alloc(ParticleArrays *pa, unsigned int capacity) {
+    void *block = PARTIKEL_CALLOC(1, ParticleArrays_Size(capacity) + PARTIKEL_ALIGNMENT - 1);
+    if(block == NULL) {
+        return false;
     }
+    ParticleArrays_Place(pa, capacity, AlignPointer(block));
+    pa->block = block;
 
     return true;
 }
 
-// Emitter_Start activates Particle emission.
-void Emitter_Start(Emitter *e) {
-    e->isEmitting = true;
+// ParticleArrays_Free frees all arrays if they are owned by the ParticleArrays.
+void ParticleArrays_Free(ParticleArrays *pa) {
+    PARTIKEL_FREE(pa->block);
+    *pa = (ParticleArrays){0};
 }
 
-// Emitter_Start deactivates Particle emission.
-void Emitter_Stop(Emitter *e) {
-    e->isEmitting = false;
+// ParticleArrays_Move copies the particle at index from in src to index to in dst.
+// Both may be the same ParticleArrays.
+void ParticleArrays_Move(ParticleArrays *dst, unsigned int to, ParticleArrays *src, unsigned int from) {
+    dst->originX[to] = src->originX[from];
+    dst->originY[to] = src->originY[from];
+    dst->positionX[to] = src->positionX[from];
+    dst->positionY[to] = src->positionY[from];
+    dst->velocityX[to] = src->velocityX[from];
+    dst->velocityY[to] = src->velocityY[from];
+    dst->scaleX[to] = src->scaleX[from];
+    dst->scaleY[to] = src->scaleY[from];
+    dst->rotation[to] = src->rotation[from];
+    dst->rotationSpeed[to] = src->rotationSpeed[from];
+    dst->originAcceleration[to] = src->originAcceleration[from];
+    dst->age[to] = src->age[from];
+    dst->ttl[to] = src->ttl[from];
+    dst->invTtl[to] = src->invTtl[from];
 }
 
-// Emitter_Free frees all allocated resources.
-void Emitter_Free(Emitter *e) {
-    for(unsigned int i = 0; i < e->config.capacity; i++) {
-        Particle_Free(e->particles[i]);
+// ParticleArrays_MoveAll copies the live particles of src to an empty dst, as many as fit.
+static void ParticleArrays_MoveAll(ParticleArrays *dst, ParticleArrays *src) {
+    while(dst->length < src->length && dst->length < dst->capacity) {
+        ParticleArrays_Move(dst, dst->length, src, dst->length);
+        dst->length++;
     }
-    free(e->particles);
-    free(e);
 }
 
-// Emitter_Burst emits a specified amount of particles at once,
-// ignoring the state of e->isEmitting. Use this for singular events
-// instead of continuous output.
-void Emitter_Burst(Emitter *e) {
-    if (!e->isActive)
-        return;
+// ParticleArrays_Relayout lays out pa for capacity particles within its own memory, which
+// must be at least ParticleArrays_Size(capacity) bytes long. Live particles are kept as long
+// as they fit. Arrays move to the front when shrinking and to the back when growing, so they
+// are moved in that order to never overwrite one which has not been moved yet.
+static void ParticleArrays_Relayout(ParticleArrays *pa, unsigned int capacity) {
+    unsigned char *memory = (unsigned char *)pa->originX;
+    size_t oldStride = PARTIKEL_ALIGN_UP((size_t)pa->capacity * sizeof(float));
+    size_t newStride = PARTIKEL_ALIGN_UP((size_t)capacity * sizeof(float));
+    unsigned int length = pa->length < capacity ? pa->length : capacity;
+    void *block = pa->block;
 
-    Particle *p = NULL;
-    int emitted = 0;
+    for(unsigned int k = 0; k < PARTIKEL_FLOAT_ARRAYS; k++) {
+        unsigned int i = newStride <= oldStride ? k : PARTIKEL_FLOAT_ARRAYS - 1 - k;
+        memmove(memory + i * newStride, memory + i * oldStride, length * sizeof(float));
+    }
 
-    int amount = GetRandomValue(e->config.burst.min, e->config.burst.max);
+    ParticleArrays_Place(pa, capacity, memory);
+    pa->length = length;
+    pa->block = block;
+}
 
-    for(unsigned int i = 0; i < e->config.capacity; i++) {
-        p = e->particles[i];
-        if(!p->active) {
-            Particle_Init(p, &e->config);
-            p->position = e->config.origin;
-            emitted++;
-        }
-        if(emitted >= amount) {
-            return;
-        }
-    }
+// Particle_Advance moves p by t seconds along its path, with or without its external
+// acceleration. t may be negative.
+static void Particle_Advance(Particle *p, float t, bool accelerate) {
+    Vector2 a = accelerate ? p->externalAcceleration : (Vector2){0, 0};
+    p->position.x += p->velocity.x * t + 0.5f * a.x * t * t;
+    p->position.y += p->velocity.y * t + 0.5f * a.y * t * t;
+    p->velocity.x += a.x * t;
+    p->velocity.y += a.y * t;
+    p->scale.x += p->scaleIncrease.x * t;
+    p->scale.y += p->scaleIncrease.y * t;
+    // Kept within +-360 degrees like integrated rotations, however long t is.
+    p->rotation = fmodf(p->rotation + p->rotationSpeed * t, 360.0f);
 }
 
-// Emitter_Update updates all particles and returns
-// the current amount of active particles.
-unsigned long Emitter_Update(Emitter *e, float dt) {
-    unsigned int emitNow = 0;
-    Particle *p = NULL;
-    unsigned long counter = 0;
+// ParticleArrays_Get gathers the particle at index i into a Particle object.
+// Per emitter properties are taken from the given EmitterConfig. The result is a copy,
+// used to hand particles to the deactivator and draw callbacks.
+Particle ParticleArrays_Get(ParticleArrays *pa, EmitterConfig *cfg, unsigned int i) {
+    Particle p = {
+        .origin = (Vector2){.x = pa->originX[i], .y = pa->originY[i]},
+        .position = (Vector2){.x = pa->positionX[i], .y = pa->positionY[i]},
+        .velocity = (Vector2){.x = pa->velocityX[i], .y = pa->velocityY[i]},
+        .externalAcceleration = cfg->externalAcceleration,
+        .scale = (Vector2){.x = pa->scaleX[i], .y = pa->scaleY[i]},
+        .scaleIncrease = cfg->scaleIncrease,
+        .rotation = pa->rotation[i],
+        .rotationSpeed = pa->rotationSpeed[i],
+        .originAcceleration = pa->originAcceleration[i],
+        .age = pa->age[i],
+        .ttl = pa->ttl[i],
+        .active = i < pa->length,
 
-    if(e->isEmitting) {
-        e->mustEmit += dt * (float)e->config.emissionRate;
-        emitNow = (unsigned int)e->mustEmit; // floor
+        .particle_Deactivator = cfg->particle_Deactivator != NULL ? cfg->particle_Deactivator
+                                                                   : Particle_DeactivatorAge
+    };
+    // Ballistic particles are stored in their spawn state.
+    if(EmitterConfig_IsBallistic(cfg)) {
+        Particle_Advance(&p, p.age, true);
     }
+    return p;
+}
 
-    for(unsigned int i = 0; i < e->config.capacity; i++) {
-        p = e->particles[i];
-        if(p->active) {
-            Particle_Update(p, dt);
-            counter++;
-        } else if(e->isEmitting && emitNow > 0) {
-            // emit new particles here
-            Particle_Init(p, &e->config);
-            Particle_Update(p, dt);
-            emitNow--;
-            e->mustEmit--;
-            counter++;
-        }
-    }
+// ParticleArrays_Init inits the particle at index i exactly like Particle_InitRandom does.
+void ParticleArrays_Init(ParticleArrays *pa, unsigned int i, EmitterConfig *cfg, Random *r) {
+    Particle p;
+    Particle_InitRandom(&p, cfg, r);
 
-    return counter;
+    pa->originX[i] = p.origin.x;
+    pa->originY[i] = p.origin.y;
+    pa->positionX[i] = p.position.x;
+    pa->positionY[i] = p.position.y;
+    pa->velocityX[i] = p.velocity.x;
+    pa->velocityY[i] = p.velocity.y;
+    pa->scaleX[i] = p.scale.x;
+    pa->scaleY[i] = p.scale.y;
+    pa->rotation[i] = p.rotation;
+    pa->rotationSpeed[i] = p.rotationSpeed;
+    pa->originAcceleration[i] = p.originAcceleration;
+    pa->age[i] = p.age;
+    pa->ttl[i] = p.ttl;
+    pa->invTtl[i] = p.ttl > 0 ? 1.0f / p.ttl : 0.0f;
 }
 
-// Emitter_Draw draws all active particles.
-void Emitter_Draw(Emitter *e) {
-    BeginBlendMode(e->config.blendMode);
-    for(unsigned int i = 0; i < e->config.capacity; i++) {
-        Particle *p = e->particles[i];
-        if(p->active)
-            e->config.particle_Draw(e, p);
+// LUTEntry returns the ParticleLUT entry for a normalized age (age / ttl).
+static unsigned int LUTEntry(float time) {
+    float f = time * (float)(PARTIKEL_LUT_SIZE - 1) + 0.5f;
+    return (unsigned int)fminf(fmaxf(f, 0.0f), (float)(PARTIKEL_LUT_SIZE - 1));
+}
+
+// ParticleArrays_LUTIndex returns the ParticleLUT entry for the age of the particle at index i.
+unsigned int ParticleArrays_LUTIndex(ParticleArrays *pa, unsigned int i) {
+    return LUTEntry(pa->age[i] * pa->invTtl[i]);
+}
+
+// CurveSegment finds the keys around time. Returns the index of the key starting
+// the segment and sets fraction to the position of time within the segment.
+// Times before the first or after the last key are clamped to it.
+static unsigned int CurveSegment(float *times, unsigned int stride, unsigned int count, float time, float *fraction) {
+    *fraction = 0;
+    if(time <= times[0]) {
+        return 0;
     }
-    EndBlendMode();
+    for(unsigned int k = 0; k + 1 < count; k++) {
+        float t0 = times[k*stride];
+        float t1 = times[(k+1)*stride];
+        if(time < t1) {
+            *fraction = t1 > t0 ? (time - t0) / (t1 - t0) : 0;
+            return k;
+        }
+    }
+    return count - 1;
 }
 
-// Particlesystem_New creates a new particle system
-// with the given amount of emitters.
-ParticleSystem * ParticleSystem_New(void) {
-    ParticleSystem *ps = calloc(1, sizeof(ParticleSystem));
-    if(ps == NULL) {
-        return NULL;
+// FloatCurve_Evaluate returns the value of curve at the normalized age time,
+// or fallback if the curve has no keys.
+float FloatCurve_Evaluate(FloatCurve *curve, float time, float fallback) {
+    unsigned int count = curve->count < PARTIKEL_MAX_KEYS ? curve->count : PARTIKEL_MAX_KEYS;
+    if(count == 0) {
+        return fallback;
     }
-    ps->active = false;
-    ps->length = 0;
-    ps->capacity = 1;
-    ps->origin = (Vector2){.x = 0, .y = 0};
-    ps->emitters = calloc(ps->capacity, sizeof(Emitter*));
-    if(ps->emitters == NULL) {
-        free(ps);
-        return NULL;
+    float fraction;
+    unsigned int k = CurveSegment(&curve->keys[0].time, sizeof(FloatKey) / sizeof(float), count, time, &fraction);
+    if(k + 1 >= count) {
+        return curve->keys[k].value;
     }
-    return ps;
+    return curve->keys[k].value + (curve->keys[k+1].value - curve->keys[k].value) * fraction;
 }
 
-// ParticleSystem_Register registers an emitter to the system.
-// The emitter will be controlled by all particle system functions.
-// Returns true on success and false otherwise.
-bool ParticleSystem_Register(ParticleSystem *ps, Emitter *emitter) {
-    // If there is no space for another emitter we have to realloc.
-    if(ps->length >= ps->capacity) {
-        // Double capacity.
-        Emitter **newEmitters = realloc(ps->emitters, 2*ps->capacity*sizeof(Emitter *));
-        if(newEmitters == NULL) {
-            return false;
-        }
-        ps->emitters = newEmitters;
-        ps->capacity *= 2;
+// ColorCurve_Evaluate returns the color of curve at the normalized age time,
+// or fallback if the curve has no keys.
+Color ColorCurve_Evaluate(ColorCurve *curve, float time, Color fallback) {
+    unsigned int count = curve->count < PARTIKEL_MAX_KEYS ? curve->count : PARTIKEL_MAX_KEYS;
+    if(count == 0) {
+        return fallback;
+    }
+    float fraction;
+    unsigned int k = CurveSegment(&curve->keys[0].time, sizeof(ColorKey) / sizeof(float), count, time, &fraction);
+    if(k + 1 >= count) {
+        return curve->keys[k].color;
     }
+    return LinearFade(curve->keys[k].color, curve->keys[k+1].color, fraction);
+}
 
-    // Now the new Emitter can be registered.
-    ps->emitters[ps->length] = emitter;
-    ps->length++;
+// ParticleLUT_Bake samples all properties over life described by cfg.
+void ParticleLUT_Bake(ParticleLUT *lut, EmitterConfig *cfg) {
+    lut->hasScale = false;
+    lut->hasDamping = false;
 
-    return true;
-}
+    for(unsigned int k = 0; k < PARTIKEL_LUT_SIZE; k++) {
+        float time = (float)k / (float)(PARTIKEL_LUT_SIZE - 1);
 
-// ParticleSystem_Deregister deregisters an Emitter by its pointer.
-// Returns true on success and false otherwise.
-bool ParticleSystem_Deregister(ParticleSystem *ps, Emitter *emitter) {
-    for(unsigned int i = 0; i < ps->length; i++) {
-        if(ps->emitters[i] == emitter) {
-            // Remove this emitter by replacing its pointer with the
-            // last pointer, if it is not the only Emitter.
-            if(i != ps->length-1) {
-                ps->emitters[i] = ps->emitters[ps->length-1];
-            }
-            // Then NULL the last emitter. It is either a duplicate or
-            // the removed one.
-            ps->length--;
-            ps->emitters[ps->length] = NULL;
+        Color color = ColorCurve_Evaluate(&cfg->colorOverLife, time,
+                                          LinearFade(cfg->startColor, cfg->endColor, time));
+        float alpha = FloatCurve_Evaluate(&cfg->alphaOverLife, time, 1.0f);
+        color.a = (unsigned char)fminf(fmaxf((float)color.a * alpha + 0.5f, 0.0f), 255.0f);
+        lut->color[k] = color;
 
-            return true;
-        }
+        lut->scale[k] = FloatCurve_Evaluate(&cfg->scaleOverLife, time, 1.0f);
+        lut->damping[k] = FloatCurve_Evaluate(&cfg->dampingOverLife, time, 0.0f);
+        lut->hasScale = lut->hasScale || lut->scale[k] != 1.0f;
+        lut->hasDamping = lut->hasDamping || lut->damping[k] != 0.0f;
     }
-    // Emitter not found.
-    return false;
 }
 
-// ParticleSystem_SetOrigin sets the origin for all registered Emitters.
-void ParticleSystem_SetOrigin(ParticleSystem *ps, Vector2 origin) {
-    ps->origin = origin;
-    for(unsigned int i = 0; i < ps->length; i++) {
-        ps->emitters[i]->config.origin = origin;
+// ParticleArrays_Damp scales the velocity of the particles [begin, end) down by
+// the damping over life in lut.
+void ParticleArrays_Damp(ParticleArrays *pa, ParticleLUT *lut, unsigned int begin, unsigned int end, float dt) {
+    for(unsigned int i = begin; i < end; i++) {
+        float keep = fmaxf(1.0f - lut->damping[ParticleArrays_LUTIndex(pa, i)] * dt, 0.0f);
+        pa->velocityX[i] *= keep;
+        pa->velocityY[i] *= keep;
     }
 }
 
-// ParticleSystem_SetDirectionAngle sets the direction angle for all registered Emitters.
-void ParticleSystem_SetDirectionAngle(ParticleSystem *ps, FloatRange range) {
-    for(unsigned int i = 0; i < ps->length; i++) {
-        ps->emitters[i]->config.directionAngle = range;
+// ParticleArrays_ExpireRange ages the particles [begin, end) by dt and removes the ones
+// rejected by the deactivator. Removed particles are replaced by the last particle of the
+// range, so the survivors end up packed at the start of the range. pa->length is not changed.
+// Returns the amount of particles still alive in the range.
+unsigned int ParticleArrays_ExpireRange(ParticleArrays *pa, EmitterConfig *cfg, unsigned int begin, unsigned int end, float dt) {
+    bool (*deactivator)(Particle *) = cfg->particle_Deactivator;
+    if(deactivator == Particle_DeactivatorAge) {
+        deactivator = NULL;
     }
-}
+    unsigned int i = begin;
 
-// ParticleSystem_SetBaseRotation sets the base rotation for all registered Emitters.
-void ParticleSystem_SetBaseRotation(ParticleSystem *ps, float rotation) {
-    for(unsigned int i = 0; i < ps->length; i++) {
-        ps->emitters[i]->config.baseRotation = rotation;
-    }
-}
+    while(i < end) {
+        pa->age[i] += dt;
 
-// ParticleSystem_Start runs Emitter_Start on all registered Emitters.
-void ParticleSystem_Start(ParticleSystem *ps) {
-    for(unsigned int i = 0; i < ps->length; i++) {
-        Emitter_Start(ps->emitters[i]);
+        bool dead;
+        if(deactivator == NULL) {
+            dead = pa->age[i] > pa->ttl[i];
+        } else {
+            Particle p = ParticleArrays_Get(pa, cfg, i);
+            dead = deactivator(&p);
+        }
+
+        if(dead) {
+            // Fill the hole with the last particle of the range. It has not
+            // been aged yet, so index i is processed again.
+            end--;
+            if(i != end) {
+                ParticleArrays_Move(pa, i, pa, end);
+            }
+            continue;
+        }
+        i++;
     }
+
+    return end - begin;
 }
 
-// ParticleSystem_Stop runs Emitter_Stop on all registered Emitters.
-void ParticleSystem_Stop(ParticleSystem *ps) {
-    for(unsigned int i = 0; i < ps->length; i++) {
-        Emitter_Stop(ps->emitters[i]);
-    }
+// ParticleArrays_Expire ages all live particles by dt and removes the ones rejected by
+// the deactivator. Removed particles are replaced by the last live particle.
+// Returns the amount of particles still alive.
+unsigned long ParticleArrays_Expire(ParticleArrays *pa, EmitterConfig *cfg, float dt) {
+    pa->length = ParticleArrays_ExpireRange(pa, cfg, 0, pa->length, dt);
+    return pa->length;
 }
 
-// ParticleSystem_Burst runs Emitter_Burst on all registered Emitters.
-void ParticleSystem_Burst(ParticleSystem *ps) {
-    for(unsigned int i = 0; i < ps->length; i++) {
-        Emitter_Burst(ps->emitters[i]);
+// ParticleArrays_Compact packs particles expired chunk by chunk back into [0, length).
+// Chunk c starts at c * chunkSize and has its live[c] survivors at its start, as left
+// by ParticleArrays_ExpireRange. Holes are filled with the last survivors, so only as
+// many particles move as have died below the new length. Returns the new length.
+unsigned long ParticleArrays_Compact(ParticleArrays *pa, unsigned int chunkSize, const unsigned int *live, unsigned int chunks) {
+    unsigned int length = 0;
+    for(unsigned int c = 0; c < chunks; c++) {
+        length += live[c];
     }
-}
 
-// ParticleSystem_Draw runs Emitter_Draw on all registered Emitters.
-void ParticleSystem_Draw(ParticleSystem *ps) {
-    for(unsigned int i = 0; i < ps->length; i++) {
-        Emitter_Draw(ps->emitters[i]);
+    unsigned int src = chunks;      // Chunk survivors are taken from.
+    unsigned int srcEnd = 0;        // One past its last survivor not taken yet.
+
+    for(unsigned int c = 0; c < chunks; c++) {
+        unsigned int hole = c * chunkSize + live[c];
+        unsigned int holeEnd = (c + 1) * chunkSize < length ? (c + 1) * chunkSize : length;
+
+        while(hole < holeEnd) {
+            // There are exactly as many survivors at or past length as holes
+            // below it, so this never runs out of chunks.
+            while(src == chunks || srcEnd == src * chunkSize) {
+                src--;
+                srcEnd = src * chunkSize + live[src];
+            }
+            srcEnd--;
+            ParticleArrays_Move(pa, hole, pa, srcEnd);
+            hole++;
+        }
     }
+
+    pa->length = length;
+    return length;
 }
 
-// ParticleSystem_Update runs Emitter_Update on all registered Emitters.
-unsigned long ParticleSystem_Update(ParticleSystem *ps, float dt) {
-    unsigned int counter = 0;
-    for(unsigned int i = 0; i < ps->length; i++) {
-        counter += Emitter_Update(ps->emitters[i], dt);
+// IntegrateParams holds the per emitter constants of one integration step.
+typedef struct IntegrateParams {
+    float dt;
+    float accx;     // External acceleration multiplied by dt.
+    float accy;
+    float scalex;   // Scale increase multiplied by dt.
+    float scaley;
+} IntegrateParams;
+
+// IntegrateScalar moves, scales and rotates the particles [begin, end) by one step.
+static void IntegrateScalar(ParticleArrays *pa, unsigned int begin, unsigned int end, IntegrateParams *ip) {
+    float dt = ip->dt;
+
+    for(unsigned int i = begin; i < end; i++) {
+        Vector2 toOrigin = NormalizeV2((Vector2){
+            .x = pa->originX[i] - pa->positionX[i],
+            .y = pa->originY[i] - pa->positionY[i]
+        });
+
+        // Update velocity by internal and external acceleration.
+        pa->velocityX[i] += toOrigin.x * pa->originAcceleration[i] * dt + ip->accx;
+        pa->velocityY[i] += toOrigin.y * pa->originAcceleration[i] * dt + ip->accy;
+
+        // Update position by velocity.
+        pa->positionX[i] += pa->velocityX[i] * dt;
+        pa->positionY[i] += pa->velocityY[i] * dt;
+
+        // Update particle scale
+        pa->scaleX[i] += ip->scalex;
+        pa->scaleY[i] += ip->scaley;
+
+        // Update particle rotation
+        float rotation = pa->rotation[i] + pa->rotationSpeed[i] * dt;
+
+        if (rotation < 0)
+            rotation += 360.0f;
+        else if (rotation > 360.0f)
+            rotation -= 360.0f;
+
+        pa->rotation[i] = rotation;
     }
-    return counter;
+}
+
+#if !defined(PARTIKEL_NO_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+    #define PARTIKEL_SIMD_X86
+    #include <immintrin.h>
+    #if defined(_MSC_VER) && !defined(__clang__)
+        #include <intrin.h>
+        #define PARTIKEL_TARGET(isa)
+    #else
+        #define PARTIKEL_TARGET(isa) __attribute__((target(isa)))
+    #endif
+#endif
+
+#ifdef PARTIKEL_SIMD_X86
+
+// IntegrateSSE2 is IntegrateScalar for 4 particles at a time.
+PARTIKEL_TARGET("sse2")
+static void IntegrateSSE2(ParticleArrays *pa, unsigned int begin, unsigned int end, IntegrateParams *ip) {
+    const __m128 dt = _mm_set1_ps(ip->dt);
+    const __m128 accx = _mm_set1_ps(ip->accx);
+    const __m128 accy = _mm_set1_ps(ip->accy);
+    const __m128 scalex = _mm_set1_ps(ip->scalex);
+    const __m128 scaley = _mm_set1_ps(ip->scaley);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    const __m128 full = _mm_set1_ps(360.0f);
+    unsigned int i = begin;
+
+    for(; i + 4 <= end; i += 4) {
+        __m128 px = _mm_loadu_ps(pa->positionX + i);
+        __m128 py = _mm_loadu_ps(pa->positionY + i);
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(pa->originX + i), px);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(pa->originY + i), py);
+
+        // Normalize (dx, dy) with a refined reciprocal square root. Zero vectors stay zero.
+        __m128 lenSq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        __m128 rs = _mm_rsqrt_ps(lenSq);
+        rs = _mm_mul_ps(rs, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, lenSq), _mm_mul_ps(rs, rs))));
+        rs = _mm_and_ps(rs, _mm_cmpgt_ps(lenSq, zero));
+
+        __m128 pull = _mm_mul_ps(_mm_mul_ps(rs, _mm_loadu_ps(pa->originAcceleration + i)), dt);
+        __m128 vx = _mm_add_ps(_mm_loadu_ps(pa->velocityX + i), _mm_add_ps(_mm_mul_ps(dx, pull), accx));
+        __m128 vy = _mm_add_ps(_mm_loadu_ps(pa->velocityY + i), _mm_add_ps(_mm_mul_ps(dy, pull), accy));
+        _mm_storeu_ps(pa->velocityX + i, vx);
+        _mm_storeu_ps(pa->velocityY + i, vy);
+        _mm_storeu_ps(pa->positionX + i, _mm_add_ps(px, _mm_mul_ps(vx, dt)));
+        _mm_storeu_ps(pa->positionY + i, _mm_add_ps(py, _mm_mul_ps(vy, dt)));
+
+        _mm_storeu_ps(pa->scaleX + i, _mm_add_ps(_mm_loadu_ps(pa->scaleX + i), scalex));
+        _mm_storeu_ps(pa->scaleY + i, _mm_add_ps(_mm_loadu_ps(pa->scaleY + i), scaley));
+
+        // Branchless wrap of the rotation into 0..360.
+        __m128 r = _mm_add_ps(_mm_loadu_ps(pa->rotation + i), _mm_mul_ps(_mm_loadu_ps(pa->rotationSpeed + i), dt));
+        r = _mm_add_ps(r, _mm_and_ps(_mm_cmplt_ps(r, zero), full));
+        r = _mm_sub_ps(r, _mm_and_ps(_mm_cmpgt_ps(r, full), full));
+        _mm_storeu_ps(pa->rotation + i, r);
+    }
+
+    IntegrateScalar(pa, i, end, ip);
+}
+
+// IntegrateAVX2 is IntegrateScalar for 8 particles at a time.
+PARTIKEL_TARGET("avx2")
+static void IntegrateAVX2(ParticleArrays *pa, unsigned int begin, unsigned int end, IntegrateParams *ip) {
+    const __m256 dt = _mm256_set1_ps(ip->dt);
+    const __m256 accx = _mm256_set1_ps(ip->accx);
+    const __m256 accy = _mm256_set1_ps(ip->accy);
+    const __m256 scalex = _mm256_set1_ps(ip->scalex);
+    const __m256 scaley = _mm256_set1_ps(ip->scaley);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalves = _mm256_set1_ps(1.5f);
+    const __m256 full = _mm256_set1_ps(360.0f);
+    unsigned int i = begin;
+
+    for(; i + 8 <= end; i += 8) {
+        __m256 px = _mm256_loadu_ps(pa->positionX + i);
+        __m256 py = _mm256_loadu_ps(pa->positionY + i);
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(pa->originX + i), px);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(pa->originY + i), py);
+
+        // Normalize (dx, dy) with a refined reciprocal square root. Zero vectors stay zero.
+        __m256 lenSq = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+        __m256 rs = _mm256_rsqrt_ps(lenSq);
+        rs = _mm256_mul_ps(rs, _mm256_sub_ps(threeHalves, _mm256_mul_ps(_mm256_mul_ps(half, lenSq), _mm256_mul_ps(rs, rs))));
+        rs = _mm256_and_ps(rs, _mm256_cmp_ps(lenSq, zero, _CMP_GT_OQ));
+
+        __m256 pull = _mm256_mul_ps(_mm256_mul_ps(rs, _mm256_loadu_ps(pa->originAcceleration + i)), dt);
+        __m256 vx = _mm256_add_ps(_mm256_loadu_ps(pa->velocityX + i), _mm256_add_ps(_mm256_mul_ps(dx, pull), accx));
+        __m256 vy = _mm256_add_ps(_mm256_loadu_ps(pa->velocityY + i), _mm256_add_ps(_mm256_mul_ps(dy, pull), accy));
+        _mm256_storeu_ps(pa->velocityX + i, vx);
+        _mm256_storeu_ps(pa->velocityY + i, vy);
+        _mm256_storeu_ps(pa->positionX + i, _mm256_add_ps(px, _mm256_mul_ps(vx, dt)));
+        _mm256_storeu_ps(pa->positionY + i, _mm256_add_ps(py, _mm256_mul_ps(vy, dt)));
+
+        _mm256_storeu_ps(pa->scaleX + i, _mm256_add_ps(_mm256_loadu_ps(pa->scaleX + i), scalex));
+        _mm256_storeu_ps(pa->scaleY + i, _mm256_add_ps(_mm256_loadu_ps(pa->scaleY + i), scaley));
+
+        // Branchless wrap of the rotation into 0..360.
+        __m256 r = _mm256_add_ps(_mm256_loadu_ps(pa->rotation + i), _mm256_mul_ps(_mm256_loadu_ps(pa->rotationSpeed + i), dt));
+        r = _mm256_add_ps(r, _mm256_and_ps(_mm256_cmp_ps(r, zero, _CMP_LT_OQ), full));
+        r = _mm256_sub_ps(r, _mm256_and_ps(_mm256_cmp_ps(r, full, _CMP_GT_OQ), full));
+        _mm256_storeu_ps(pa->rotation + i, r);
+    }
+
+    IntegrateScalar(pa, i, end, ip);
+}
+
+// DetectSimdLevel returns the widest kernel the CPU and OS support.
+static SimdLevel DetectSimdLevel(void) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if(info[0] >= 7) {
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        if(osxsave && avx && avx2 && (_xgetbv(0) & 0x6) == 0x6) {
+            return SIMD_AVX2;
+        }
+    }
+    return SIMD_SSE2;
+#else
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+    if(__builtin_cpu_supports("sse2")) {
+        return SIMD_SSE2;
+    }
+    return SIMD_SCALAR;
+#endif
+}
+
+#else
+
+static SimdLevel DetectSimdLevel(void) {
+    return SIMD_SCALAR;
+}
+
+#endif // PARTIKEL_SIMD_X86
+
+// The detected and the selected kernel. -1 until detection ran.
+static int supportedSimdLevel = -1;
+static int simdLevel = -1;
+
+// ParticleArrays_GetSimdLevel returns the kernel used by ParticleArrays_Integrate.
+// Detects the CPU features on first use.
+SimdLevel ParticleArrays_GetSimdLevel(void) {
+    if(simdLevel < 0) {
+        supportedSimdLevel = DetectSimdLevel();
+        simdLevel = supportedSimdLevel;
+    }
+    return (SimdLevel)simdLevel;
+}
+
+// ParticleArrays_SetSimdLevel selects the kernel used by ParticleArrays_Integrate,
+// e.g. to compare against the scalar kernel. Levels the CPU does not support are
+// lowered to the best supported one. Returns the selected level.
+SimdLevel ParticleArrays_SetSimdLevel(SimdLevel level) {
+    ParticleArrays_GetSimdLevel();
+    simdLevel = (int)level < supportedSimdLevel ? (int)level : supportedSimdLevel;
+    return (SimdLevel)simdLevel;
+}
+
+// ParticleArrays_Integrate moves, scales and rotates the particles [begin, end) by dt,
+// using the widest kernel selected by ParticleArrays_SetSimdLevel.
+// Ballistic particles are not integrated, they are evaluated from their spawn state.
+void ParticleArrays_Integrate(ParticleArrays *pa, EmitterConfig *cfg, unsigned int begin, unsigned int end, float dt) {
+    if(EmitterConfig_IsBallistic(cfg)) {
+        return;
+    }
+
+    IntegrateParams ip = {
+        .dt = dt,
+        .accx = cfg->externalAcceleration.x * dt,
+        .accy = cfg->externalAcceleration.y * dt,
+        .scalex = cfg->scaleIncrease.x * dt,
+        .scaley = cfg->scaleIncrease.y * dt
+    };
+
+    switch(ParticleArrays_GetSimdLevel()) {
+#ifdef PARTIKEL_SIMD_X86
+    case SIMD_AVX2:
+        IntegrateAVX2(pa, begin, end, &ip);
+        break;
+    case SIMD_SSE2:
+        IntegrateSSE2(pa, begin, end, &ip);
+        break;
+#endif
+    default:
+        IntegrateScalar(pa, begin, end, &ip);
+        break;
+    }
+}
+
+// EmitterConfig_IsBallistic returns true if the particles of cfg move ballistically: motion is
+// PARTICLE_MOTION_BALLISTIC, originAcceleration is 0 and there is no damping over life.
+// Their arrays then hold the spawn state and are never integrated, the state at age t is
+//     position = position + velocity * t + externalAcceleration * t^2 / 2
+//     velocity = velocity + externalAcceleration * t
+//     scale = scale + scaleIncrease * t
+//     rotation = rotation + rotationSpeed * t, wrapped to +-360 degrees
+// Updating them only ages them. Other configs asking for ballistic motion are integrated.
+// A custom particle_Deactivator gives up most of the gain: it is handed every particle
+// every update, evaluated at its age from all of its arrays.
+bool EmitterConfig_IsBallistic(EmitterConfig *cfg) {
+    return cfg->motion == PARTICLE_MOTION_BALLISTIC
+           && cfg->originAcceleration.min == 0 && cfg->originAcceleration.max == 0
+           && cfg->dampingOverLife.count == 0;
+}
+
+// ParticleArrays_SetBallistic converts all live particles between the state integrated
+// with cfg and the spawn state of ballistic motion with cfg, see EmitterConfig_IsBallistic.
+void ParticleArrays_SetBallistic(ParticleArrays *pa, EmitterConfig *cfg, bool ballistic) {
+    float ax = cfg->externalAcceleration.x;
+    float ay = cfg->externalAcceleration.y;
+    // Going back to the spawn state runs time backwards.
+    float sign = ballistic ? -1.0f : 1.0f;
+
+    for(unsigned int i = 0; i < pa->length; i++) {
+        float t = sign * pa->age[i];
+        pa->positionX[i] += pa->velocityX[i] * t + 0.5f * ax * t * t;
+        pa->positionY[i] += pa->velocityY[i] * t + 0.5f * ay * t * t;
+        pa->velocityX[i] += ax * t;
+        pa->velocityY[i] += ay * t;
+        pa->scaleX[i] += cfg->scaleIncrease.x * t;
+        pa->scaleY[i] += cfg->scaleIncrease.y * t;
+        pa->rotation[i] = fmodf(pa->rotation[i] + pa->rotationSpeed[i] * t, 360.0f);
+    }
+}
+
+// ParticleArrays_Update is Particle_Update for all live particles at once.
+// Acceleration and scale increase are taken from the given EmitterConfig.
+// Deactivated particles are replaced by the last live particle.
+// Returns the amount of particles still alive.
+unsigned long ParticleArrays_Update(ParticleArrays *pa, EmitterConfig *cfg, float dt) {
+    ParticleArrays_Expire(pa, cfg, dt);
+    ParticleArrays_Integrate(pa, cfg, 0, pa->length, dt);
+
+    return pa->length;
+}
+
+// Amount of particles ParticleArrays_Spawn prepares on the stack at once.
+#define PARTIKEL_SPAWN_BATCH 256
+
+// ParticleArrays_Spawn inits up to n new particles right behind the live ones.
+// The new particles are found at [length - spawned, length).
+// Random values are drawn in the same order as n calls to ParticleArrays_Init would,
+// but all rotations are computed in one pass with SinCosDegrees.
+// Returns the amount of particles spawned, which is less than n if the arrays are full.
+unsigned int ParticleArrays_Spawn(ParticleArrays *pa, EmitterConfig *cfg, Random *r, unsigned int n) {
+    unsigned int room = pa->capacity - pa->length;
+    if(n > room) {
+        n = room;
+    }
+
+    float directionAngle[PARTIKEL_SPAWN_BATCH];
+    float velocityAngle[PARTIKEL_SPAWN_BATCH];
+    float velocity[PARTIKEL_SPAWN_BATCH];
+    float offset[PARTIKEL_SPAWN_BATCH];
+    float sines[PARTIKEL_SPAWN_BATCH], cosines[PARTIKEL_SPAWN_BATCH];
+    Vector2 dir = cfg->direction;
+
+    for(unsigned int done = 0; done < n; ) {
+        unsigned int count = n - done < PARTIKEL_SPAWN_BATCH ? n - done : PARTIKEL_SPAWN_BATCH;
+        unsigned int base = pa->length;
+
+        // Draw all random values.
+        for(unsigned int k = 0; k < count; k++) {
+            unsigned int i = base + k;
+            directionAngle[k] = RandomFloat(r, cfg->directionAngle.min, cfg->directionAngle.max);
+            velocity[k] = RandomFloat(r, cfg->velocity.min, cfg->velocity.max);
+            // Velocity is rotated by both angles.
+            velocityAngle[k] = directionAngle[k] + RandomFloat(r, cfg->velocityAngle.min, cfg->velocityAngle.max);
+            offset[k] = RandomFloat(r, cfg->offset.min, cfg->offset.max);
+            pa->originAcceleration[i] = RandomFloat(r, cfg->originAcceleration.min, cfg->originAcceleration.max);
+            pa->ttl[i] = RandomFloat(r, cfg->age.min, cfg->age.max);
+            pa->invTtl[i] = pa->ttl[i] > 0 ? 1.0f / pa->ttl[i] : 0.0f;
+            pa->rotationSpeed[i] = RandomFloat(r, cfg->rotationSpeed.min, cfg->rotationSpeed.max);
+        }
+
+        // Offset the position along the rotated direction.
+        SinCosDegrees(directionAngle, sines, cosines, count);
+        for(unsigned int k = 0; k < count; k++) {
+            unsigned int i = base + k;
+            float dx = cosines[k] * dir.x - sines[k] * dir.y;
+            float dy = sines[k] * dir.x + cosines[k] * dir.y;
+            pa->positionX[i] = cfg->origin.x + dx * offset[k];
+            pa->positionY[i] = cfg->origin.y + dy * offset[k];
+        }
+
+        SinCosDegrees(velocityAngle, sines, cosines, count);
+        for(unsigned int k = 0; k < count; k++) {
+            unsigned int i = base + k;
+            pa->velocityX[i] = (cosines[k] * dir.x - sines[k] * dir.y) * velocity[k];
+            pa->velocityY[i] = (sines[k] * dir.x + cosines[k] * dir.y) * velocity[k];
+        }
+
+        // Properties shared by all new particles.
+        for(unsigned int i = base; i < base + count; i++) {
+            pa->originX[i] = cfg->origin.x;
+            pa->originY[i] = cfg->origin.y;
+            pa->scaleX[i] = cfg->baseScale.x;
+            pa->scaleY[i] = cfg->baseScale.y;
+            pa->rotation[i] = cfg->baseRotation;
+            pa->age[i] = 0;
+        }
+
+        pa->length += count;
+        done += count;
+    }
+
+    return n;
+}
+
+// DrawLag returns how many seconds the drawn state of the particle at index i lies behind
+// its simulated state, see ParticleSystem_SetFixedStep. Particles emitted since the last
+// step are drawn where they are, they never lag behind their spawn.
+static float DrawLag(Emitter *e, unsigned int i) {
+    return e->renderLag > 0 ? fminf(e->renderLag, e->particles.age[i]) : 0.0f;
+}
+
+// GatherInstances prepares the particles [begin, begin + count) of e for drawing,
+// with the texture offset, scale over life and color over life applied.
+static void GatherInstances(Emitter *e, unsigned int begin, unsigned int count, ParticleInstance *out) {
+    ParticleArrays *pa = &e->particles;
+    Vector2 scaleIncrease = e->config.scaleIncrease;
+    bool ballistic = EmitterConfig_IsBallistic(&e->config);
+    Vector2 acceleration = ballistic ? e->config.externalAcceleration : (Vector2){0, 0};
+
+    for(unsigned int k = 0; k < count; k++) {
+        unsigned int i = begin + k;
+        float lag = DrawLag(e, i);
+        // Integrated particles are moved back by the lag, ballistic ones forward from their spawn.
+        float t = ballistic ? pa->age[i] - lag : -lag;
+        float half = ballistic ? 0.5f * t * t : 0.0f;
+        unsigned int entry = LUTEntry((pa->age[i] - lag) * pa->invTtl[i]);
+        out[k] = (ParticleInstance){
+            .x = pa->positionX[i] + pa->velocityX[i] * t + acceleration.x * half - e->offset.x,
+            .y = pa->positionY[i] + pa->velocityY[i] * t + acceleration.y * half - e->offset.y,
+            .scaleX = (pa->scaleX[i] + scaleIncrease.x * t) * e->lut->scale[entry],
+            .scaleY = (pa->scaleY[i] + scaleIncrease.y * t) * e->lut->scale[entry],
+            .rotation = fmodf(pa->rotation[i] + pa->rotationSpeed[i] * t, 360.0f),
+            .color = e->lut->color[entry]
+        };
+    }
+}
+
+// Instanced drawing.
+//----------------------------------------------------------------------------------
+
+#ifdef PARTIKEL_INSTANCING
+
+// rlSetVertexAttribute takes the attribute offset as pointer before raylib v5.0.
+#if defined(RAYLIB_VERSION_MAJOR) && RAYLIB_VERSION_MAJOR >= 5
+    #define PARTIKEL_ATTRIB_OFFSET(offset) ((int)(offset))
+#else
+    #define PARTIKEL_ATTRIB_OFFSET(offset) ((const void *)(uintptr_t)(offset))
+#endif
+
+// Every instance is a textured quad around its position. quad holds the texture
+// size in xy and the texture origin in zw.
+static const char *instancedVertexShader =
+    "#version 330\n"
+    "in vec2 vertexCorner;\n"
+    "in vec4 instancePositionScale;\n"
+    "in float instanceRotation;\n"
+    "in vec4 instanceColor;\n"
+    "uniform mat4 mvp;\n"
+    "uniform vec4 quad;\n"
+    "out vec2 fragTexCoord;\n"
+    "out vec4 fragColor;\n"
+    "void main() {\n"
+    "    vec2 local = (vertexCorner*quad.xy - quad.zw)*instancePositionScale.zw;\n"
+    "    float c = cos(radians(instanceRotation));\n"
+    "    float s = sin(radians(instanceRotation));\n"
+    "    vec2 world = instancePositionScale.xy + vec2(c*local.x - s*local.y, s*local.x + c*local.y);\n"
+    "    fragTexCoord = vertexCorner;\n"
+    "    fragColor = instanceColor;\n"
+    "    gl_Position = mvp*vec4(world, 0.0, 1.0);\n"
+    "}\n";
+
+static const char *instancedFragmentShader =
+    "#version 330\n"
+    "in vec2 fragTexCoord;\n"
+    "in vec4 fragColor;\n"
+    "uniform sampler2D texture0;\n"
+    "out vec4 finalColor;\n"
+    "void main() {\n"
+    "    finalColor = texture(texture0, fragTexCoord)*fragColor;\n"
+    "}\n";
+
+// The shader shared by all Emitters and its locations.
+static struct {
+    unsigned int id;
+    bool failed;
+    int mvp, quad, texture;
+    int corner, positionScale, rotation, color;
+} instancedShader = {0};
+
+// LoadInstancedShader loads the shader on first use.
+// Returns false if instancing is not available.
+static bool LoadInstancedShader(void) {
+    if(instancedShader.id != 0) {
+        return true;
+    }
+    if(instancedShader.failed) {
+        return false;
+    }
+
+    int version = rlGetVersion();
+    if(version == RL_OPENGL_33 || version == RL_OPENGL_43) {
+        instancedShader.id = rlLoadShaderCode(instancedVertexShader, instancedFragmentShader);
+    }
+    if(instancedShader.id == 0) {
+        instancedShader.failed = true;
+        return false;
+    }
+
+    instancedShader.mvp = rlGetLocationUniform(instancedShader.id, "mvp");
+    instancedShader.quad = rlGetLocationUniform(instancedShader.id, "quad");
+    instancedShader.texture = rlGetLocationUniform(instancedShader.id, "texture0");
+    instancedShader.corner = rlGetLocationAttrib(instancedShader.id, "vertexCorner");
+    instancedShader.positionScale = rlGetLocationAttrib(instancedShader.id, "instancePositionScale");
+    instancedShader.rotation = rlGetLocationAttrib(instancedShader.id, "instanceRotation");
+    instancedShader.color = rlGetLocationAttrib(instancedShader.id, "instanceColor");
+
+    return true;
+}
+
+// UnloadInstancedShader unloads the shader used by PARTICLE_DRAW_INSTANCED.
+// Call it before closing the window if any Emitter was drawn instanced.
+void UnloadInstancedShader(void) {
+    if(instancedShader.id != 0) {
+        rlUnloadShaderProgram(instancedShader.id);
+    }
+    instancedShader.id = 0;
+    instancedShader.failed = false;
+}
+
+// SetInstanceAttribute describes one attribute of ParticleInstance, advancing once per instance.
+static void SetInstanceAttribute(int location, int size, int type, bool normalized, size_t offset) {
+    if(location < 0) {
+        return;
+    }
+    rlSetVertexAttribute((unsigned int)location, size, type, normalized, sizeof(ParticleInstance),
+                         PARTIKEL_ATTRIB_OFFSET(offset));
+    rlEnableVertexAttribute((unsigned int)location);
+    rlSetVertexAttributeDivisor((unsigned int)location, 1);
+}
+
+// ParticleInstances_Unload releases the GPU buffers.
+static void ParticleInstances_Unload(ParticleInstances *pi) {
+    if(pi->vao != 0) {
+        rlUnloadVertexArray(pi->vao);
+        rlUnloadVertexBuffer(pi->quadVbo);
+        rlUnloadVertexBuffer(pi->instanceVbo);
+    }
+    pi->vao = pi->quadVbo = pi->instanceVbo = 0;
+}
+
+// ParticleInstances_Reserve makes room for count instances.
+// Returns true on success and false otherwise.
+static bool ParticleInstances_Reserve(ParticleInstances *pi, unsigned int count) {
+    if(count <= pi->capacity && pi->vao != 0) {
+        return true;
+    }
+
+    unsigned int capacity = pi->capacity > 0 ? pi->capacity : 256;
+    while(capacity < count) {
+        capacity *= 2;
+    }
+    ParticleInstance *data = PARTIKEL_REALLOC(pi->data, capacity * sizeof(ParticleInstance));
+    if(data == NULL) {
+        return false;
+    }
+    pi->data = data;
+    pi->capacity = capacity;
+
+    // Two triangles spanning the unit square, also used as texture coordinates.
+    static const float corners[] = {0, 0, 0, 1, 1, 1, 0, 0, 1, 1, 1, 0};
+
+    ParticleInstances_Unload(pi);
+    pi->vao = rlLoadVertexArray();
+    if(pi->vao == 0) {
+        return false;
+    }
+    rlEnableVertexArray(pi->vao);
+
+    pi->quadVbo = rlLoadVertexBuffer(corners, sizeof(corners), false);
+    if(instancedShader.corner >= 0) {
+        rlSetVertexAttribute((unsigned int)instancedShader.corner, 2, RL_FLOAT, false, 0, PARTIKEL_ATTRIB_OFFSET(0));
+        rlEnableVertexAttribute((unsigned int)instancedShader.corner);
+    }
+
+    pi->instanceVbo = rlLoadVertexBuffer(NULL, (int)(capacity * sizeof(ParticleInstance)), true);
+    SetInstanceAttribute(instancedShader.positionScale, 4, RL_FLOAT, false, offsetof(ParticleInstance, x));
+    SetInstanceAttribute(instancedShader.rotation, 1, RL_FLOAT, false, offsetof(ParticleInstance, rotation));
+    SetInstanceAttribute(instancedShader.color, 4, RL_UNSIGNED_BYTE, true, offsetof(ParticleInstance, color));
+
+    rlDisableVertexArray();
+
+    return true;
+}
+
+// MultiplyMatrix returns left*right like raymath's MatrixMultiply.
+static Matrix MultiplyMatrix(Matrix left, Matrix right) {
+    Matrix result;
+    result.m0 = left.m0*right.m0 + left.m1*right.m4 + left.m2*right.m8 + left.m3*right.m12;
+    result.m1 = left.m0*right.m1 + left.m1*right.m5 + left.m2*right.m9 + left.m3*right.m13;
+    result.m2 = left.m0*right.m2 + left.m1*right.m6 + left.m2*right.m10 + left.m3*right.m14;
+    result.m3 = left.m0*right.m3 + left.m1*right.m7 + left.m2*right.m11 + left.m3*right.m15;
+    result.m4 = left.m4*right.m0 + left.m5*right.m4 + left.m6*right.m8 + left.m7*right.m12;
+    result.m5 = left.m4*right.m1 + left.m5*right.m5 + left.m6*right.m9 + left.m7*right.m13;
+    result.m6 = left.m4*right.m2 + left.m5*right.m6 + left.m6*right.m10 + left.m7*right.m14;
+    result.m7 = left.m4*right.m3 + left.m5*right.m7 + left.m6*right.m11 + left.m7*right.m15;
+    result.m8 = left.m8*right.m0 + left.m9*right.m4 + left.m10*right.m8 + left.m11*right.m12;
+    result.m9 = left.m8*right.m1 + left.m9*right.m5 + left.m10*right.m9 + left.m11*right.m13;
+    result.m10 = left.m8*right.m2 + left.m9*right.m6 + left.m10*right.m10 + left.m11*right.m14;
+    result.m11 = left.m8*right.m3 + left.m9*right.m7 + left.m10*right.m11 + left.m11*right.m15;
+    result.m12 = left.m12*right.m0 + left.m13*right.m4 + left.m14*right.m8 + left.m15*right.m12;
+    result.m13 = left.m12*right.m1 + left.m13*right.m5 + left.m14*right.m9 + left.m15*right.m13;
+    result.m14 = left.m12*right.m2 + left.m13*right.m6 + left.m14*right.m10 + left.m15*right.m14;
+    result.m15 = left.m12*right.m3 + left.m13*right.m7 + left.m14*right.m11 + left.m15*right.m15;
+    return result;
+}
+
+// DrawInstances draws count prepared instances with the texture of e in one
+// instanced draw call. Returns false if instancing is not available.
+static bool DrawInstances(Emitter *e, const ParticleInstance *data, unsigned int count) {
+    ParticleInstances *pi = &e->instances;
+
+    if(!LoadInstancedShader() || !ParticleInstances_Reserve(pi, count)) {
+        return false;
+    }
+    if(count == 0) {
+        return true;
+    }
+
+    // Draw everything batched so far, so the particles end up on top of it.
+    rlDrawRenderBatchActive();
+    rlUpdateVertexBuffer(pi->instanceVbo, data, (int)(count * sizeof(ParticleInstance)), 0);
+
+    Texture2D tex = e->config.texture;
+    float quad[4] = {(float)tex.width, (float)tex.height, e->config.textureOrigin.x, e->config.textureOrigin.y};
+    int slot = 0;
+
+    rlEnableShader(instancedShader.id);
+    rlSetUniformMatrix(instancedShader.mvp, MultiplyMatrix(rlGetMatrixModelview(), rlGetMatrixProjection()));
+    rlSetUniform(instancedShader.quad, quad, RL_SHADER_UNIFORM_VEC4, 1);
+    rlSetUniform(instancedShader.texture, &slot, RL_SHADER_UNIFORM_INT, 1);
+    rlActiveTextureSlot(0);
+    rlEnableTexture(tex.id);
+    rlEnableVertexArray(pi->vao);
+    rlDrawVertexArrayInstanced(0, 6, (int)count);
+    rlDisableVertexArray();
+    rlDisableTexture();
+    rlDisableShader();
+
+    return true;
+}
+
+// DrawInstanced draws all live particles of e with one instanced draw call.
+// Returns false if instancing is not available.
+static bool DrawInstanced(Emitter *e) {
+    ParticleArrays *pa = &e->particles;
+    ParticleInstances *pi = &e->instances;
+
+    if(!LoadInstancedShader() || !ParticleInstances_Reserve(pi, pa->length)) {
+        return false;
+    }
+    GatherInstances(e, 0, pa->length, pi->data);
+    return DrawInstances(e, pi->data, pa->length);
+}
+
+#else
+
+static void ParticleInstances_Unload(ParticleInstances *pi) {
+    (void)pi;
+}
+
+#ifndef PARTIKEL_NO_RAYLIB
+
+static bool DrawInstances(Emitter *e, const ParticleInstance *data, unsigned int count) {
+    (void)e;
+    (void)data;
+    (void)count;
+    return false;
+}
+
+static bool DrawInstanced(Emitter *e) {
+    (void)e;
+    return false;
+}
+
+void UnloadInstancedShader(void) {
+}
+
+#endif // PARTIKEL_NO_RAYLIB
+
+#endif // PARTIKEL_INSTANCING
+
+// ParticleInstances_Free releases all buffers used for instanced drawing.
+static void ParticleInstances_Free(ParticleInstances *pi) {
+    ParticleInstances_Unload(pi);
+    PARTIKEL_FREE(pi->data);
+    *pi = (ParticleInstances){0};
+}
+
+#ifndef PARTIKEL_NO_RAYLIB
+
+// Batched drawing.
+//----------------------------------------------------------------------------------
+
+// Amount of particles DrawBatched prepares and submits at once.
+// Must fit into one rlgl render batch.
+#define PARTIKEL_DRAW_BATCH 1024
+
+// DrawQuads draws count prepared instances as textured quads, exactly like DrawTexturePro
+// would. The corners of a whole chunk of particles are computed in one loop, then
+// submitted to the rlgl batch. The texture must be set by the caller.
+static void DrawQuads(Texture2D tex, Vector2 origin, const ParticleInstance *data, unsigned int count) {
+    float width = (float)tex.width;
+    float height = (float)tex.height;
+
+    float rotations[PARTIKEL_DRAW_BATCH], sines[PARTIKEL_DRAW_BATCH], cosines[PARTIKEL_DRAW_BATCH];
+    float cornerX[4*PARTIKEL_DRAW_BATCH], cornerY[4*PARTIKEL_DRAW_BATCH];
+
+    for(unsigned int begin = 0; begin < count; begin += PARTIKEL_DRAW_BATCH) {
+        const ParticleInstance *chunk = data + begin;
+        unsigned int n = count - begin < PARTIKEL_DRAW_BATCH ? count - begin : PARTIKEL_DRAW_BATCH;
+
+        for(unsigned int k = 0; k < n; k++) {
+            // SinCosDegrees is only valid within +-90000 degrees.
+            rotations[k] = fmodf(chunk[k].rotation, 360.0f);
+        }
+        SinCosDegrees(rotations, sines, cosines, n);
+
+        // Top left, bottom left, bottom right and top right corner of every quad.
+        for(unsigned int k = 0; k < n; k++) {
+            float x = chunk[k].x;
+            float y = chunk[k].y;
+            float left = -origin.x * chunk[k].scaleX;
+            float top = -origin.y * chunk[k].scaleY;
+            float right = left + width * chunk[k].scaleX;
+            float bottom = top + height * chunk[k].scaleY;
+            float c = cosines[k];
+            float s = sines[k];
+
+            cornerX[4*k + 0] = x + left*c - top*s;
+            cornerY[4*k + 0] = y + left*s + top*c;
+            cornerX[4*k + 1] = x + left*c - bottom*s;
+            cornerY[4*k + 1] = y + left*s + bottom*c;
+            cornerX[4*k + 2] = x + right*c - bottom*s;
+            cornerY[4*k + 2] = y + right*s + bottom*c;
+            cornerX[4*k + 3] = x + right*c - top*s;
+            cornerY[4*k + 3] = y + right*s + top*c;
+        }
+
+        // Flush the current batch if the whole chunk does not fit anymore.
+        rlCheckRenderBatchLimit(4*(int)n);
+
+        rlBegin(RL_QUADS);
+        rlNormal3f(0.0f, 0.0f, 1.0f);
+        for(unsigned int k = 0; k < n; k++) {
+            Color color = chunk[k].color;
+            rlColor4ub(color.r, color.g, color.b, color.a);
+            rlTexCoord2f(0.0f, 0.0f);
+            rlVertex2f(cornerX[4*k + 0], cornerY[4*k + 0]);
+            rlTexCoord2f(0.0f, 1.0f);
+            rlVertex2f(cornerX[4*k + 1], cornerY[4*k + 1]);
+            rlTexCoord2f(1.0f, 1.0f);
+            rlVertex2f(cornerX[4*k + 2], cornerY[4*k + 2]);
+            rlTexCoord2f(1.0f, 0.0f);
+            rlVertex2f(cornerX[4*k + 3], cornerY[4*k + 3]);
+        }
+        rlEnd();
+    }
+}
+
+// DrawBatched draws all live particles of e as textured quads, see DrawQuads.
+static void DrawBatched(Emitter *e) {
+    ParticleArrays *pa = &e->particles;
+    ParticleInstance batch[PARTIKEL_DRAW_BATCH];
+
+    rlSetTexture(e->config.texture.id);
+
+    for(unsigned int begin = 0; begin < pa->length; begin += PARTIKEL_DRAW_BATCH) {
+        unsigned int count = pa->length - begin < PARTIKEL_DRAW_BATCH ? pa->length - begin : PARTIKEL_DRAW_BATCH;
+        GatherInstances(e, begin, count, batch);
+        DrawQuads(e->config.texture, e->config.textureOrigin, batch, count);
+    }
+
+    rlSetTexture(0);
+}
+
+#endif // PARTIKEL_NO_RAYLIB
+
+// Emitter_OwnLUT replaces the ParticleLUT e shares with an EffectTemplate by a copy of its own.
+// Returns false if there is not enough memory for it, e still shares the ParticleLUT then.
+static bool Emitter_OwnLUT(Emitter *e) {
+    void *block = PARTIKEL_CALLOC(1, sizeof(ParticleLUT) + PARTIKEL_ALIGNMENT - 1);
+    if(block == NULL) {
+        return false;
+    }
+    ParticleLUT *lut = AlignPointer(block);
+    *lut = *e->lut;
+    e->lutBlock = block;
+    e->lut = lut;
+    e->sharesLUT = false;
+
+    return true;
+}
+
+// Emitter_Create creates an Emitter reading the given ParticleLUT, or baking its own if shared is NULL.
+// The Emitter, its own ParticleLUT and all of its particles are allocated as a single block.
+static Emitter * Emitter_Create(EmitterConfig cfg, ParticleLUT *shared) {
+    size_t header = PARTIKEL_ALIGN_UP(sizeof(Emitter)) + (shared == NULL ? PARTIKEL_ALIGN_UP(sizeof(ParticleLUT)) : 0);
+    void *block = PARTIKEL_CALLOC(1, header + ParticleArrays_Size(cfg.capacity) + PARTIKEL_ALIGNMENT - 1);
+    if(block == NULL) {
+        return NULL;
+    }
+    Emitter *e = AlignPointer(block);
+    e->block = block;
+    e->config = cfg;
+    e->offset.x = 0;
+    e->offset.y = 0;
+    e->isActive = true;
+    e->lut = shared != NULL ? shared : (ParticleLUT *)((unsigned char *)e + PARTIKEL_ALIGN_UP(sizeof(Emitter)));
+    e->sharesLUT = shared != NULL;
+    e->blockParticles = (unsigned char *)e + header;
+    e->blockCapacity = cfg.capacity;
+    ParticleArrays_Place(&e->particles, e->config.capacity, e->blockParticles);
+    e->mustEmit = 0;
+    Random_Seed(&e->random, cfg.seed != 0 ? cfg.seed : (unsigned int)RandomValue());
+    // Normalize direction for future uses.
+    e->config.direction = NormalizeV2(e->config.direction);
+    if(!e->sharesLUT) {
+        Emitter_BakeLUT(e);
+    }
+
+    return e;
+}
+
+// Emitter_New creates a new Emitter object.
+// The Emitter, its ParticleLUT and all of its particles are allocated as a single block.
+Emitter * Emitter_New(EmitterConfig cfg) {
+    return Emitter_Create(cfg, NULL);
+}
+
+// Emitter_Reinit reinits the given Emitter with a new EmitterConfig.
+// Particles are kept within the Emitter's block as long as the new capacity fits into the
+// capacity it was created with. Only a larger capacity moves them to storage of their own,
+// as the block holds the Emitter itself and cannot move. Live particles are kept as long
+// as they fit into the new capacity. Returns false if there is not enough memory, e is
+// left unchanged then.
+bool Emitter_Reinit(Emitter *e, EmitterConfig cfg) {
+    // Allocate everything first, so nothing has to be undone on failure.
+    bool resize = cfg.capacity != e->particles.capacity;
+    ParticleArrays newParticles = {0};
+    if(resize && cfg.capacity > e->blockCapacity && !ParticleArrays_Alloc(&newParticles, cfg.capacity)) {
+        return false;
+    }
+    if(e->sharesLUT && !Emitter_OwnLUT(e)) {
+        ParticleArrays_Free(&newParticles);
+        return false;
+    }
+
+    if(resize && cfg.capacity > e->blockCapacity) {
+        ParticleArrays_MoveAll(&newParticles, &e->particles);
+        ParticleArrays_Free(&e->particles);
+        e->particles = newParticles;
+    } else if(resize && e->particles.block != NULL) {
+        // Back into the Emitter's block, freeing the storage of a former larger capacity.
+        ParticleArrays_Place(&newParticles, cfg.capacity, e->blockParticles);
+        ParticleArrays_MoveAll(&newParticles, &e->particles);
+        ParticleArrays_Free(&e->particles);
+        e->particles = newParticles;
+    } else if(resize) {
+        ParticleArrays_Relayout(&e->particles, cfg.capacity);
+    }
+
+    // Ballistic particles are rebased, so changes apply from now on and not since their spawn.
+    bool wasBallistic = EmitterConfig_IsBallistic(&e->config);
+    bool isBallistic = EmitterConfig_IsBallistic(&cfg);
+    bool pathChanged = e->config.externalAcceleration.x != cfg.externalAcceleration.x
+                       || e->config.externalAcceleration.y != cfg.externalAcceleration.y
+                       || e->config.scaleIncrease.x != cfg.scaleIncrease.x
+                       || e->config.scaleIncrease.y != cfg.scaleIncrease.y;
+    if(wasBallistic != isBallistic || (isBallistic && pathChanged)) {
+        if(wasBallistic) {
+            ParticleArrays_SetBallistic(&e->particles, &e->config, false);
+        }
+        if(isBallistic) {
+            ParticleArrays_SetBallistic(&e->particles, &cfg, true);
+        }
+    }
+
+    // Restart the random sequence if a new seed is given.
+    if(cfg.seed != 0 && cfg.seed != e->config.seed) {
+        Random_Seed(&e->random, cfg.seed);
+    }
+
+    // Set new config.
+    e->config = cfg;
+    ParticleLUT_Bake(e->lut, &e->config);
+
+    return true;
+}
+
+// Emitter_Start activates Particle emission.
+void Emitter_Start(Emitter *e) {
+    e->isEmitting = true;
+}
+
+// Emitter_Start deactivates Particle emission.
+void Emitter_Stop(Emitter *e) {
+    e->isEmitting = false;
+}
+
+// Emitter_Free frees all allocated resources.
+void Emitter_Free(Emitter *e) {
+    ParticleInstances_Free(&e->instances);
+    ParticleArrays_Free(&e->particles);
+    if(e->lutBlock != NULL) {
+        PARTIKEL_FREE(e->lutBlock);
+    }
+    if(e->metadata != NULL) {
+        PARTIKEL_FREE(e->metadata);
+    }
+    PARTIKEL_FREE(e->block);
+}
+
+// Emitter_Burst emits a specified amount of particles at once,
+// ignoring the state of e->isEmitting. Use this for singular events
+// instead of continuous output.
+void Emitter_Burst(Emitter *e) {
+    if (!e->isActive)
+        return;
+
+    ParticleArrays *pa = &e->particles;
+
+    int amount = Random_Int(&e->random, e->config.burst.min, e->config.burst.max);
+    if(amount <= 0) {
+        return;
+    }
+
+    unsigned int emitted = Emitter_SpawnBatch(e, (unsigned int)amount);
+
+    for(unsigned int i = pa->length - emitted; i < pa->length; i++) {
+        pa->positionX[i] = e->config.origin.x;
+        pa->positionY[i] = e->config.origin.y;
+    }
+}
+
+// Emitter_SpawnBatch spawns up to n particles at once, ignoring the state
+// of e->isEmitting. The new particles are not updated until the next Emitter_Update.
+// Returns the amount of particles spawned, which is less than n if the Emitter is full.
+unsigned int Emitter_SpawnBatch(Emitter *e, unsigned int n) {
+    return ParticleArrays_Spawn(&e->particles, &e->config, &e->random, n);
+}
+
+// Emitter_Emit spawns the particles due after dt seconds of emission behind the live ones.
+// Returns the amount of particles spawned.
+unsigned int Emitter_Emit(Emitter *e, float dt) {
+    unsigned int emitNow = 0;
+
+    if(e->isEmitting) {
+        e->mustEmit += dt * (float)e->config.emissionRate;
+        emitNow = (unsigned int)e->mustEmit; // floor
+    }
+
+    if(emitNow == 0) {
+        return 0;
+    }
+    unsigned int emitted = Emitter_SpawnBatch(e, emitNow);
+    e->mustEmit -= (float)emitted;
+    return emitted;
+}
+
+// Emitter_Simulate ages, damps and moves all live particles by dt, without emitting.
+// Returns the current amount of active particles.
+unsigned long Emitter_Simulate(Emitter *e, float dt) {
+    ParticleArrays *pa = &e->particles;
+
+    ParticleArrays_Expire(pa, &e->config, dt);
+    if(e->lut->hasDamping) {
+        ParticleArrays_Damp(pa, e->lut, 0, pa->length, dt);
+    }
+    ParticleArrays_Integrate(pa, &e->config, 0, pa->length, dt);
+
+    return pa->length;
+}
+
+// Emitter_Update updates all particles and returns
+// the current amount of active particles.
+unsigned long Emitter_Update(Emitter *e, float dt) {
+    // New particles are updated together with all other live particles.
+    Emitter_Emit(e, dt);
+    return Emitter_Simulate(e, dt);
+}
+
+// Step Emitter_Prewarm updates Emitters whose particles have no closed-form motion.
+#define PARTIKEL_PREWARM_STEP (1.0f / 60.0f)
+
+// Emitter_Steps updates e for seconds in steps of PARTIKEL_PREWARM_STEP, the last step
+// taking the rest. Without emit particles only age and move, until none are left.
+static void Emitter_Steps(Emitter *e, float seconds, bool emit) {
+    unsigned int steps = (unsigned int)ceilf(seconds / PARTIKEL_PREWARM_STEP);
+    for(unsigned int i = 0; i < steps && (emit || e->particles.length > 0); i++) {
+        float dt = i + 1 < steps ? PARTIKEL_PREWARM_STEP : seconds - (float)(steps - 1) * PARTIKEL_PREWARM_STEP;
+        if(emit) {
+            Emitter_Update(e, dt);
+        } else {
+            Emitter_Simulate(e, dt);
+        }
+    }
+}
+
+// ParticleArrays_SpawnAt spawns one particle at index i, replacing the particle there
+// if i is below pa->length and appending it otherwise.
+static void ParticleArrays_SpawnAt(ParticleArrays *pa, EmitterConfig *cfg, Random *r, unsigned int i) {
+    unsigned int length = pa->length;
+    pa->length = i;
+    ParticleArrays_Spawn(pa, cfg, r, 1);
+    pa->length = i < length ? length : i + 1;
+}
+
+// Particles of Emitter_Prewarm hold minus their spawn time as age, so this is the time
+// the particle at index i dies at.
+#define PARTIKEL_DEATH(pa, i) ((pa)->ttl[i] - (pa)->age[i])
+
+// DeathHeap_Down restores the order of heap, the n slots of pa sorted by the time their
+// particles die at, after the death time of slot heap[k] went up.
+static void DeathHeap_Down(ParticleArrays *pa, unsigned int *heap, unsigned int n, unsigned int k) {
+    for(;;) {
+        unsigned int min = k;
+        for(unsigned int c = 2 * k + 1; c <= 2 * k + 2 && c < n; c++) {
+            if(PARTIKEL_DEATH(pa, heap[c]) < PARTIKEL_DEATH(pa, heap[min])) {
+                min = c;
+            }
+        }
+        if(min == k) {
+            return;
+        }
+        unsigned int tmp = heap[k];
+        heap[k] = heap[min];
+        heap[min] = tmp;
+        k = min;
+    }
+}
+
+// DeathHeap_Up restores the order of heap after slot heap[k] was added.
+static void DeathHeap_Up(ParticleArrays *pa, unsigned int *heap, unsigned int k) {
+    while(k > 0 && PARTIKEL_DEATH(pa, heap[k]) < PARTIKEL_DEATH(pa, heap[(k - 1) / 2])) {
+        unsigned int tmp = heap[k];
+        heap[k] = heap[(k - 1) / 2];
+        heap[(k - 1) / 2] = tmp;
+        k = (k - 1) / 2;
+    }
+}
+
+// Emitter_Prewarm fast-forwards e by seconds of emission, e.g. to start an effect in its
+// steady state. Like Emitter_Update, a full Emitter keeps its particles, spawns due
+// emissions as slots free up and carries the rest over in mustEmit. Without origin
+// acceleration and damping, particles move on closed-form paths: live particles are aged
+// and moved at once, and the emissions still alive after seconds are spawned directly at
+// their age. A custom deactivator is asked about the final state only. Other configs, and
+// custom deactivators if e could fill up, are updated in steps of PARTIKEL_PREWARM_STEP.
+// Emissions older than age.max are skipped if e can't fill up and there is no custom
+// deactivator, which may keep particles past their ttl.
+// Returns the amount of active particles.
+unsigned long Emitter_Prewarm(Emitter *e, float seconds) {
+    ParticleArrays *pa = &e->particles;
+    if(!e->isActive || seconds <= 0) {
+        return pa->length;
+    }
+
+    double rate = e->isEmitting ? (double)e->config.emissionRate : 0.0;
+    EmitterConfig cfg = e->config;
+    cfg.motion = PARTICLE_MOTION_BALLISTIC;
+    bool customDeactivator = cfg.particle_Deactivator != NULL && cfg.particle_Deactivator != Particle_DeactivatorAge;
+
+    // Seconds before the end emissions can still be alive at.
+    float window = seconds;
+    if(!customDeactivator && cfg.age.max < seconds) {
+        window = cfg.age.max > 0 ? cfg.age.max : 0;
+    }
+    // Without backlog no more than the emissions of one window are alive at once.
+    bool fits = (double)pa->length + e->mustEmit + window * rate + 1 <= (double)pa->capacity;
+
+    // Emission k happens once mustEmit reaches k, (k - mustEmit) / rate seconds in.
+    double due = e->mustEmit + seconds * rate;
+    double last = floor(due);
+
+    if(!EmitterConfig_IsBallistic(&cfg) || (customDeactivator && !fits && rate > 0)) {
+        if(!fits) {
+            Emitter_Steps(e, seconds, true);
+            return pa->length;
+        }
+        Emitter_Steps(e, seconds - window, false);
+        double skipped = e->mustEmit + (seconds - window) * rate;
+        e->mustEmit = (float)(skipped - floor(skipped));
+        Emitter_Steps(e, window, true);
+        return pa->length;
+    }
+
+    // Age live particles in their spawn state, see EmitterConfig_IsBallistic.
+    bool ballistic = EmitterConfig_IsBallistic(&e->config);
+    if(!ballistic) {
+        ParticleArrays_SetBallistic(pa, &cfg, true);
+    }
+
+    if(rate > 0 && fits) {
+        double first = ceil(due - window * rate);
+        if(first < 1) {
+            first = 1;
+        }
+        if(first <= last) {
+            unsigned int base = pa->length;
+            ParticleArrays_Spawn(pa, &cfg, &e->random, (unsigned int)(last - first) + 1);
+            for(unsigned int i = base; i < pa->length; i++) {
+                pa->age[i] = (float)-fmax((first + (i - base) - e->mustEmit) / rate, 0.0);
+            }
+        }
+        e->mustEmit = (float)(due - last);
+    } else if(rate > 0) {
+        // Replay the emissions, each taking the slot of the particle dying first once
+        // e is full, until one would have to wait past the end.
+        unsigned int *heap = PARTIKEL_CALLOC(pa->capacity, sizeof(unsigned int));
+        if(heap == NULL) {
+            if(!ballistic) {
+                ParticleArrays_SetBallistic(pa, &cfg, false);
+            }
+            Emitter_Steps(e, seconds, true);
+            return pa->length;
+        }
+        unsigned int n = pa->length;
+        for(unsigned int i = 0; i < n; i++) {
+            heap[i] = i;
+            DeathHeap_Up(pa, heap, i);
+        }
+
+        double k = 1;
+        for(; k <= last; k++) {
+            float spawn = (float)fmax((k - e->mustEmit) / rate, 0.0);
+            if(n < pa->capacity && (n == 0 || PARTIKEL_DEATH(pa, heap[0]) >= spawn)) {
+                ParticleArrays_SpawnAt(pa, &cfg, &e->random, n);
+                pa->age[n] = -spawn;
+                heap[n] = n;
+                DeathHeap_Up(pa, heap, n);
+                n++;
+                continue;
+            }
+            float death = PARTIKEL_DEATH(pa, heap[0]);
+            if(death >= seconds) {
+                break;
+            }
+            ParticleArrays_SpawnAt(pa, &cfg, &e->random, heap[0]);
+            pa->age[heap[0]] = -fmaxf(spawn, death);
+            DeathHeap_Down(pa, heap, n, 0);
+        }
+        e->mustEmit = (float)(due - (k - 1));
+        PARTIKEL_FREE(heap);
+    }
+    ParticleArrays_Expire(pa, &cfg, seconds);
+
+    if(!ballistic) {
+        ParticleArrays_SetBallistic(pa, &cfg, false);
+    }
+    return pa->length;
+}
+
+// Minimum amount of particles simulated by one task of Emitter_UpdateParallel,
+// and the most tasks one Emitter is split into.
+#define PARTIKEL_CHUNK_SIZE 16384
+#define PARTIKEL_MAX_CHUNKS 256
+
+// ChunkTask is the ThreadPool task simulating one chunk of an Emitter.
+typedef struct ChunkTask {
+    Emitter *e;
+    float dt;
+    unsigned int length;
+    unsigned int chunkSize;
+    unsigned int live[PARTIKEL_MAX_CHUNKS];
+} ChunkTask;
+
+static void ChunkTask_Run(void *ctx, unsigned int index) {
+    ChunkTask *task = ctx;
+    Emitter *e = task->e;
+    ParticleArrays *pa = &e->particles;
+    unsigned int begin = index * task->chunkSize;
+    unsigned int end = begin + task->chunkSize < task->length ? begin + task->chunkSize : task->length;
+
+    unsigned int live = ParticleArrays_ExpireRange(pa, &e->config, begin, end, task->dt);
+    if(e->lut->hasDamping) {
+        ParticleArrays_Damp(pa, e->lut, begin, begin + live, task->dt);
+    }
+    ParticleArrays_Integrate(pa, &e->config, begin, begin + live, task->dt);
+    task->live[index] = live;
+}
+
+// Emitter_UpdateParallel is Emitter_Update for very large Emitters. Emission runs on the
+// calling thread, then the particles are simulated in chunks on pool and packed again.
+// The result does not depend on the amount of threads in pool. Emitters too small to
+// be worth splitting are updated on the calling thread.
+unsigned long Emitter_UpdateParallel(Emitter *e, ThreadPool *pool, float dt) {
+    ParticleArrays *pa = &e->particles;
+
+    Emitter_Emit(e, dt);
+    if(pool == NULL || pa->length < 2 * PARTIKEL_CHUNK_SIZE) {
+        return Emitter_Simulate(e, dt);
+    }
+
+    ChunkTask task = {.e = e, .dt = dt, .length = pa->length};
+    task.chunkSize = (pa->length + PARTIKEL_MAX_CHUNKS - 1) / PARTIKEL_MAX_CHUNKS;
+    if(task.chunkSize < PARTIKEL_CHUNK_SIZE) {
+        task.chunkSize = PARTIKEL_CHUNK_SIZE;
+    }
+    unsigned int chunks = (pa->length + task.chunkSize - 1) / task.chunkSize;
+
+    ParticleArrays_GetSimdLevel(); // Detect the SIMD level before the workers read it.
+    ThreadPool_Run(pool, chunks, ChunkTask_Run, &task);
+
+    return ParticleArrays_Compact(pa, task.chunkSize, task.live, chunks);
+}
+
+// Emitter_LiveCount returns the current amount of live particles.
+unsigned int Emitter_LiveCount(Emitter *e) {
+    return e->particles.length;
+}
+
+// Emitter_BakeLUT bakes the properties over life from e->config.
+// Emitter_New and Emitter_Reinit do this, call it after changing colors or curves
+// in e->config directly. An Emitter reading the ParticleLUT of an EffectTemplate gets its own
+// first. Returns false if there is not enough memory for it.
+bool Emitter_BakeLUT(Emitter *e) {
+    if(e->sharesLUT && !Emitter_OwnLUT(e)) {
+        return false;
+    }
+    ParticleLUT_Bake(e->lut, &e->config);
+
+    return true;
+}
+
+// Emitter_GetParticleColor returns the color of a particle of e as baked into its ParticleLUT.
+// Meant for particle_Draw callbacks, replacing LinearFade(startColor, endColor, age/ttl).
+Color Emitter_GetParticleColor(Emitter *e, Particle *p) {
+    return e->lut->color[LUTEntry(p->ttl > 0 ? p->age / p->ttl : 0.0f)];
+}
+
+#ifndef PARTIKEL_NO_RAYLIB
+
+// Emitter_Draw draws all live particles according to e->config.drawMode.
+void Emitter_Draw(Emitter *e) {
+    ParticleArrays *pa = &e->particles;
+
+    BeginBlendMode(e->config.blendMode);
+    if(e->config.drawMode == PARTICLE_DRAW_INSTANCED && DrawInstanced(e)) {
+        // Done.
+    } else if(e->config.particle_Draw != NULL) {
+        bool ballistic = EmitterConfig_IsBallistic(&e->config);
+        for(unsigned int i = 0; i < pa->length; i++) {
+            Particle p = ParticleArrays_Get(pa, &e->config, i);
+            float lag = DrawLag(e, i);
+            if(lag > 0) {
+                Particle_Advance(&p, -lag, ballistic);
+                p.age -= lag;
+            }
+            if(e->lut->hasScale) {
+                float scale = e->lut->scale[LUTEntry(p.age * pa->invTtl[i])];
+                p.scale.x *= scale;
+                p.scale.y *= scale;
+            }
+            e->config.particle_Draw(e, &p);
+        }
+    } else {
+        DrawBatched(e);
+    }
+    EndBlendMode();
+}
+
+#endif // PARTIKEL_NO_RAYLIB
+
+// Thread pool.
+//----------------------------------------------------------------------------------
+
+#ifdef PARTIKEL_THREADS
+
+#include "pthread.h"
+#include "stdatomic.h"
+#include "unistd.h"
+
+// ThreadPool is a set of worker threads running batches of indexed tasks.
+// The thread calling ThreadPool_Run works on the batch as well.
+struct ThreadPool {
+    pthread_t *threads;
+    unsigned int threadCount;
+    pthread_mutex_t mutex;
+    pthread_cond_t start;           // Signaled when a batch is posted or the pool quits.
+    pthread_cond_t done;            // Signaled when the last worker finished a batch.
+    unsigned long generation;       // Incremented for every batch.
+    unsigned int busy;              // Workers still working on the current batch.
+    bool quit;
+
+    void (*task)(void *ctx, unsigned int index);
+    void *ctx;
+    unsigned int count;
+    atomic_uint next;               // Next task index to hand out.
+};
+
+// ThreadPool_Work runs tasks of the current batch until none are left.
+static void ThreadPool_Work(ThreadPool *pool) {
+    unsigned int i;
+    while((i = atomic_fetch_add(&pool->next, 1)) < pool->count) {
+        pool->task(pool->ctx, i);
+    }
+}
+
+// ThreadPool_Main is the loop of every worker thread.
+static void * ThreadPool_Main(void *arg) {
+    ThreadPool *pool = arg;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    for(;;) {
+        while(!pool->quit && pool->generation == seen) {
+            pthread_cond_wait(&pool->start, &pool->mutex);
+        }
+        if(pool->quit) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        ThreadPool_Work(pool);
+
+        pthread_mutex_lock(&pool->mutex);
+        if(--pool->busy == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+// ThreadPool_New creates a pool with the given amount of worker threads.
+// Passing 0 creates one worker less than there are CPUs online.
+// Returns NULL on failure.
+ThreadPool * ThreadPool_New(unsigned int threads) {
+    if(threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 1 ? (unsigned int)cpus - 1 : 0;
+    }
+
+    ThreadPool *pool = PARTIKEL_CALLOC(1, sizeof(ThreadPool));
+    if(pool == NULL) {
+        return NULL;
+    }
+    pool->threads = PARTIKEL_CALLOC(threads > 0 ? threads : 1, sizeof(pthread_t));
+    if(pool->threads == NULL) {
+        PARTIKEL_FREE(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    atomic_init(&pool->next, 0);
+
+    for(; pool->threadCount < threads; pool->threadCount++) {
+        if(pthread_create(&pool->threads[pool->threadCount], NULL, ThreadPool_Main, pool) != 0) {
+            break;
+        }
+    }
+
+    return pool;
+}
+
+// ThreadPool_Run calls task(ctx, index) for every index in [0, count) and returns once
+// all calls returned. Indices are handed out in ascending order to whichever thread is
+// free next, so expensive tasks should come first. Must not be called from a task.
+void ThreadPool_Run(ThreadPool *pool, unsigned int count, void (*task)(void *ctx, unsigned int index), void *ctx) {
+    if(pool == NULL || pool->threadCount == 0 || count <= 1) {
+        for(unsigned int i = 0; i < count; i++) {
+            task(ctx, i);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->task = task;
+    pool->ctx = ctx;
+    pool->count = count;
+    atomic_store(&pool->next, 0);
+    pool->busy = pool->threadCount;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    ThreadPool_Work(pool);
+
+    pthread_mutex_lock(&pool->mutex);
+    while(pool->busy > 0) {
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+// ThreadPool_Free stops all worker threads and frees the pool.
+void ThreadPool_Free(ThreadPool *pool) {
+    if(pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for(unsigned int i = 0; i < pool->threadCount; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->mutex);
+    PARTIKEL_FREE(pool->threads);
+    PARTIKEL_FREE(pool);
+}
+
+#else
+
+ThreadPool * ThreadPool_New(unsigned int threads) {
+    (void)threads;
+    return NULL;
+}
+
+void ThreadPool_Run(ThreadPool *pool, unsigned int count, void (*task)(void *ctx, unsigned int index), void *ctx) {
+    (void)pool;
+    for(unsigned int i = 0; i < count; i++) {
+        task(ctx, i);
+    }
+}
+
+void ThreadPool_Free(ThreadPool *pool) {
+    (void)pool;
+}
+
+#endif // PARTIKEL_THREADS
+
+// Command queue.
+//----------------------------------------------------------------------------------
+
+#ifdef PARTIKEL_THREADS
+
+// CommandSlot is one entry of a CommandQueue. Its sequence tells whose turn it is:
+// equal to the slot's position when it is free, one more once a command was written.
+typedef struct CommandSlot {
+    atomic_size_t sequence;
+    ParticleCommand command;
+} CommandSlot;
+
+// CommandQueue is a bounded lock-free ring many threads post to and one thread drains.
+struct CommandQueue {
+    CommandSlot *slots;
+    size_t mask;                // Capacity - 1, capacity is a power of two.
+    atomic_size_t tail;         // Next position to post to, shared by all producers.
+    size_t head;                // Next position to run, only touched by the consumer.
+};
+
+// CommandQueue_New creates a queue holding at least capacity commands.
+static CommandQueue * CommandQueue_New(unsigned int capacity) {
+    size_t size = 2;
+    while(size < capacity) {
+        size *= 2;
+    }
+
+    CommandQueue *q = PARTIKEL_CALLOC(1, sizeof(CommandQueue));
+    if(q == NULL) {
+        return NULL;
+    }
+    q->slots = PARTIKEL_CALLOC(size, sizeof(CommandSlot));
+    if(q->slots == NULL) {
+        PARTIKEL_FREE(q);
+        return NULL;
+    }
+    q->mask = size - 1;
+    for(size_t i = 0; i < size; i++) {
+        atomic_init(&q->slots[i].sequence, i);
+    }
+    atomic_init(&q->tail, 0);
+    q->head = 0;
+
+    return q;
+}
+
+// CommandQueue_Push appends command. Safe to call from any thread.
+// Returns false if the queue is full.
+static bool CommandQueue_Push(CommandQueue *q, ParticleCommand command) {
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    CommandSlot *slot;
+
+    for(;;) {
+        slot = &q->slots[pos & q->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+        if(diff == 0) {
+            // The slot is free, claim it unless another producer was faster.
+            if(atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1,
+                                                     memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if(diff < 0) {
+            // The slot still holds a command from one round ago.
+            return false;
+        } else {
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+        }
+    }
+
+    slot->command = command;
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+// CommandQueue_Pop takes the oldest command. Must only be called by the consuming thread.
+// Returns false if the queue is empty.
+static bool CommandQueue_Pop(CommandQueue *q, ParticleCommand *command) {
+    CommandSlot *slot = &q->slots[q->head & q->mask];
+    size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+
+    if(sequence != q->head + 1) {
+        return false;
+    }
+    *command = slot->command;
+    atomic_store_explicit(&slot->sequence, q->head + q->mask + 1, memory_order_release);
+    q->head++;
+    return true;
+}
+
+#else
+
+// CommandQueue is a bounded ring. Without PARTIKEL_THREADS commands are posted and run
+// on the same thread, so it needs no atomics.
+struct CommandQueue {
+    ParticleCommand *slots;
+    size_t mask;                // Capacity - 1, capacity is a power of two.
+    size_t tail;                // Next position to post to.
+    size_t head;                // Next position to run.
+};
+
+// CommandQueue_New creates a queue holding at least capacity commands.
+static CommandQueue * CommandQueue_New(unsigned int capacity) {
+    size_t size = 2;
+    while(size < capacity) {
+        size *= 2;
+    }
+
+    CommandQueue *q = PARTIKEL_CALLOC(1, sizeof(CommandQueue));
+    if(q == NULL) {
+        return NULL;
+    }
+    q->slots = PARTIKEL_CALLOC(size, sizeof(ParticleCommand));
+    if(q->slots == NULL) {
+        PARTIKEL_FREE(q);
+        return NULL;
+    }
+    q->mask = size - 1;
+
+    return q;
+}
+
+// CommandQueue_Push appends command. Returns false if the queue is full.
+static bool CommandQueue_Push(CommandQueue *q, ParticleCommand command) {
+    if(q->tail - q->head > q->mask) {
+        return false;
+    }
+    q->slots[q->tail & q->mask] = command;
+    q->tail++;
+    return true;
+}
+
+// CommandQueue_Pop takes the oldest command. Returns false if the queue is empty.
+static bool CommandQueue_Pop(CommandQueue *q, ParticleCommand *command) {
+    if(q->head == q->tail) {
+        return false;
+    }
+    *command = q->slots[q->head & q->mask];
+    q->head++;
+    return true;
+}
+
+#endif // PARTIKEL_THREADS
+
+// CommandQueue_Free frees the queue.
+static void CommandQueue_Free(CommandQueue *q) {
+    if(q == NULL) {
+        return;
+    }
+    PARTIKEL_FREE(q->slots);
+    PARTIKEL_FREE(q);
+}
+
+// Particlesystem_New creates a new particle system
+// with the given amount of emitters.
+ParticleSystem * ParticleSystem_New(void) {
+    ParticleSystem *ps = PARTIKEL_CALLOC(1, sizeof(ParticleSystem));
+    if(ps == NULL) {
+        return NULL;
+    }
+    ps->active = false;
+    ps->length = 0;
+    ps->capacity = 1;
+    ps->origin = (Vector2){.x = 0, .y = 0};
+    ps->emitters = PARTIKEL_CALLOC(ps->capacity, sizeof(Emitter*));
+    if(ps->emitters == NULL) {
+        PARTIKEL_FREE(ps);
+        return NULL;
+    }
+    return ps;
+}
+
+// ParticleSystem_SetThreadPool makes ParticleSystem_Update run on the given pool,
+// NULL switches back to updating on the calling thread. The pool can be shared by
+// many ParticleSystems and is not freed with them.
+void ParticleSystem_SetThreadPool(ParticleSystem *ps, ThreadPool *pool) {
+    ps->pool = pool;
+}
+
+// ParticleSystem_Register registers an emitter to the system.
+// The emitter will be controlled by all particle system functions.
+// Returns true on success and false otherwise.
+bool ParticleSystem_Register(ParticleSystem *ps, Emitter *emitter) {
+    // If there is no space for another emitter we have to realloc.
+    if(ps->length >= ps->capacity) {
+        // Double capacity.
+        Emitter **newEmitters = PARTIKEL_REALLOC(ps->emitters, 2*ps->capacity*sizeof(Emitter *));
+        if(newEmitters == NULL) {
+            return false;
+        }
+        ps->emitters = newEmitters;
+        ps->capacity *= 2;
+    }
+
+    // Now the new Emitter can be registered.
+    ps->emitters[ps->length] = emitter;
+    ps->length++;
+
+    return true;
+}
+
+// ParticleSystem_Deregister deregisters an Emitter by its pointer.
+// Returns true on success and false otherwise.
+bool ParticleSystem_Deregister(ParticleSystem *ps, Emitter *emitter) {
+    for(unsigned int i = 0; i < ps->length; i++) {
+        if(ps->emitters[i] == emitter) {
+            // Remove this emitter by replacing its pointer with the
+            // last pointer, if it is not the only Emitter.
+            if(i != ps->length-1) {
+                ps->emitters[i] = ps->emitters[ps->length-1];
+            }
+            // Then NULL the last emitter. It is either a duplicate or
+            // the removed one.
+            ps->length--;
+            ps->emitters[ps->length] = NULL;
+
+            return true;
+        }
+    }
+    // Emitter not found.
+    return false;
+}
+
+// ParticleSystem_SetOrigin sets the origin for all registered Emitters.
+void ParticleSystem_SetOrigin(ParticleSystem *ps, Vector2 origin) {
+    ps->origin = origin;
+    for(unsigned int i = 0; i < ps->length; i++) {
+        ps->emitters[i]->config.origin = origin;
+    }
+}
+
+// ParticleSystem_SetDirectionAngle sets the direction angle for all registered Emitters.
+void ParticleSystem_SetDirectionAngle(ParticleSystem *ps, FloatRange range) {
+    for(unsigned int i = 0; i < ps->length; i++) {
+        ps->emitters[i]->config.directionAngle = range;
+    }
+}
+
+// ParticleSystem_SetBaseRotation sets the base rotation for all registered Emitters.
+void ParticleSystem_SetBaseRotation(ParticleSystem *ps, float rotation) {
+    for(unsigned int i = 0; i < ps->length; i++) {
+        ps->emitters[i]->config.baseRotation = rotation;
+    }
+}
+
+// ParticleSystem_Start runs Emitter_Start on all registered Emitters.
+void ParticleSystem_Start(ParticleSystem *ps) {
+    for(unsigned int i = 0; i < ps->length; i++) {
+        Emitter_Start(ps->emitters[i]);
+    }
+}
+
+// ParticleSystem_Stop runs Emitter_Stop on all registered Emitters.
+void ParticleSystem_Stop(ParticleSystem *ps) {
+    for(unsigned int i = 0; i < ps->length; i++) {
+        Emitter_Stop(ps->emitters[i]);
+    }
+}
+
+// ParticleSystem_Burst runs Emitter_Burst on all registered Emitters.
+void ParticleSystem_Burst(ParticleSystem *ps) {
+    for(unsigned int i = 0; i < ps->length; i++) {
+        Emitter_Burst(ps->emitters[i]);
+    }
+}
+
+#ifndef PARTIKEL_NO_RAYLIB
+
+// ParticleSystem_Draw runs Emitter_Draw on all registered Emitters.
+void ParticleSystem_Draw(ParticleSystem *ps) {
+    for(unsigned int i = 0; i < ps->length; i++) {
+        Emitter_Draw(ps->emitters[i]);
+    }
+}
+
+#endif // PARTIKEL_NO_RAYLIB
+
+// UpdateTask is the ThreadPool task updating an Emitter of ps->order.
+typedef struct UpdateTask {
+    ParticleSystem *ps;
+    float dt;
+    unsigned int first;     // Index into ps->order of the first task.
+} UpdateTask;
+
+static void UpdateTask_Run(void *ctx, unsigned int index) {
+    UpdateTask *task = ctx;
+    index += task->first;
+    task->ps->counts[index] = Emitter_Update(task->ps->order[index], task->dt);
+}
+
+// UpdateParallel updates all Emitters of ps on its ThreadPool.
+// Returns false if there is not enough memory, nothing has been updated then.
+static bool UpdateParallel(ParticleSystem *ps, float dt, unsigned long *counter) {
+    if(ps->orderCapacity < ps->length) {
+        Emitter **order = PARTIKEL_REALLOC(ps->order, ps->capacity * sizeof(Emitter *));
+        if(order == NULL) {
+            return false;
+        }
+        ps->order = order;
+        unsigned long *counts = PARTIKEL_REALLOC(ps->counts, ps->capacity * sizeof(unsigned long));
+        if(counts == NULL) {
+            return false;
+        }
+        ps->counts = counts;
+        ps->orderCapacity = ps->capacity;
+    }
+
+    // Sort by live particles, biggest first, so the pool can balance the work.
+    for(unsigned int i = 0; i < ps->length; i++) {
+        Emitter *e = ps->emitters[i];
+        unsigned int j = i;
+        while(j > 0 && Emitter_LiveCount(ps->order[j-1]) < Emitter_LiveCount(e)) {
+            ps->order[j] = ps->order[j-1];
+            j--;
+        }
+        ps->order[j] = e;
+    }
+
+    // Emitters big enough to be split use the whole pool one after another,
+    // the rest is spread over the pool as one batch.
+    unsigned int big = 0;
+    while(big < ps->length && Emitter_LiveCount(ps->order[big]) >= 2 * PARTIKEL_CHUNK_SIZE) {
+        ps->counts[big] = Emitter_UpdateParallel(ps->order[big], ps->pool, dt);
+        big++;
+    }
+
+    ParticleArrays_GetSimdLevel(); // Detect the SIMD level before the workers read it.
+    UpdateTask task = {.ps = ps, .dt = dt, .first = big};
+    ThreadPool_Run(ps->pool, ps->length - big, UpdateTask_Run, &task);
+
+    *counter = 0;
+    for(unsigned int i = 0; i < ps->length; i++) {
+        *counter += ps->counts[i];
+    }
+    return true;
+}
+
+// Most simulation steps one ParticleSystem_Update runs in fixed step mode.
+// Time beyond that is dropped instead of falling further and further behind.
+#define PARTIKEL_MAX_STEPS 8
+
+// ParticleSystem_Step runs Emitter_Update on all registered Emitters.
+// Emitters are updated in parallel if the system has a ThreadPool.
+static unsigned long ParticleSystem_Step(ParticleSystem *ps, float dt) {
+    unsigned long counter = 0;
+    if(ps->pool != NULL && ps->length > 0 && UpdateParallel(ps, dt, &counter)) {
+        return counter;
+    }
+    for(unsigned int i = 0; i < ps->length; i++) {
+        counter += Emitter_Update(ps->emitters[i], dt);
+    }
+    return counter;
+}
+
+// ParticleSystem_Update runs posted commands, then updates all registered Emitters by dt,
+// or by as many fixed steps as fit into the time passed, see ParticleSystem_SetFixedStep.
+// Returns the amount of live particles.
+unsigned long ParticleSystem_Update(ParticleSystem *ps, float dt) {
+    if(ps->commands != NULL) {
+        ParticleSystem_RunCommands(ps);
+    }
+    if(ps->fixedStep <= 0) {
+        return ParticleSystem_Step(ps, dt);
+    }
+
+    ps->accumulator += dt;
+    for(unsigned int steps = 0; ps->accumulator >= ps->fixedStep && steps < PARTIKEL_MAX_STEPS; steps++) {
+        ParticleSystem_Step(ps, ps->fixedStep);
+        ps->accumulator -= ps->fixedStep;
+    }
+    if(ps->accumulator >= ps->fixedStep) {
+        ps->accumulator = fmodf(ps->accumulator, ps->fixedStep);
+    }
+
+    // Draw between the last two steps, at the point the time left over has reached.
+    for(unsigned int i = 0; i < ps->length; i++) {
+        ps->emitters[i]->renderLag = ps->fixedStep - ps->accumulator;
+    }
+
+    return ParticleSystem_LiveCount(ps);
+}
+
+// ParticleSystem_SetFixedStep makes ParticleSystem_Update simulate in steps of step seconds,
+// e.g. 1.0f / 30, independent of the frame rate. Time left over is carried to the next
+// update. Particles are drawn interpolated between their last two simulated states, so they
+// move smoothly at any frame rate, one step behind the simulation. The previous state
+// is not stored but derived from the current one: the integration moves a particle by
+// velocity * dt with its updated velocity. A step of 0 switches back to updating with the
+// dt of every update.
+void ParticleSystem_SetFixedStep(ParticleSystem *ps, float step) {
+    ps->fixedStep = step > 0 ? step : 0;
+    ps->accumulator = 0;
+    for(unsigned int i = 0; i < ps->length; i++) {
+        ps->emitters[i]->renderLag = 0;
+    }
+}
+
+// ParticleSystem_Prewarm runs Emitter_Prewarm on all registered Emitters, e.g. right
+// after loading an effect. Returns the amount of live particles.
+unsigned long ParticleSystem_Prewarm(ParticleSystem *ps, float seconds) {
+    unsigned long counter = 0;
+    for(unsigned int i = 0; i < ps->length; i++) {
+        counter += Emitter_Prewarm(ps->emitters[i], seconds);
+    }
+    return counter;
+}
+
+// ParticleSystem_LiveCount returns the amount of live particles of all registered Emitters.
+unsigned long ParticleSystem_LiveCount(ParticleSystem *ps) {
+    unsigned long counter = 0;
+    for(unsigned int i = 0; i < ps->length; i++) {
+        counter += Emitter_LiveCount(ps->emitters[i]);
+    }
+    return counter;
 }
 
 // ParticleSystem_Free only frees its own resources.
 // The emitters referenced here must be freed on their own.
 void ParticleSystem_Free(ParticleSystem *p) {
-    free(p->emitters);
-    free(p);
+    CommandQueue_Free(p->commands);
+    PARTIKEL_FREE(p->order);
+    PARTIKEL_FREE(p->counts);
+    PARTIKEL_FREE(p->emitters);
+    PARTIKEL_FREE(p);
+}
+
+// ParticleSystem_FreeAll frees all registered Emitters and the system itself,
+// e.g. for systems created by the effect loaders. Textures are not unloaded.
+void ParticleSystem_FreeAll(ParticleSystem *ps) {
+    for(unsigned int i = 0; i < ps->length; i++) {
+        Emitter_Free(ps->emitters[i]);
+    }
+    ParticleSystem_Free(ps);
+}
+
+// ParticleSystem_EnableCommands lets commands be posted to ps, at most capacity of them
+// between two updates. Must be called before ps is shared with other threads.
+// Returns true on success and false otherwise.
+bool ParticleSystem_EnableCommands(ParticleSystem *ps, unsigned int capacity) {
+    if(ps->commands != NULL) {
+        return true;
+    }
+    ps->commands = CommandQueue_New(capacity);
+    return ps->commands != NULL;
+}
+
+// ParticleSystem_Post queues command to be run by the next ParticleSystem_Update.
+// With PARTIKEL_THREADS it is safe to call from any thread, without locking.
+// Returns false if commands are not enabled or the queue is full.
+bool ParticleSystem_Post(ParticleSystem *ps, ParticleCommand command) {
+    return ps->commands != NULL && CommandQueue_Push(ps->commands, command);
+}
+
+// ParticleSystem_RunCommands runs all posted commands in order.
+// ParticleSystem_Update does this first, call it only when updating ps differently.
+// Returns the amount of commands run.
+unsigned int ParticleSystem_RunCommands(ParticleSystem *ps) {
+    ParticleCommand command;
+    unsigned int count = 0;
+
+    if(ps->commands == NULL) {
+        return 0;
+    }
+
+    while(CommandQueue_Pop(ps->commands, &command)) {
+        Emitter *e = command.emitter;
+        switch(command.type) {
+        case PARTICLE_COMMAND_BURST:
+            if(e != NULL) {
+                Emitter_Burst(e);
+            } else {
+                ParticleSystem_Burst(ps);
+            }
+            break;
+        case PARTICLE_COMMAND_SET_ORIGIN:
+            if(e != NULL) {
+                e->config.origin = command.origin;
+            } else {
+                ParticleSystem_SetOrigin(ps, command.origin);
+            }
+            break;
+        case PARTICLE_COMMAND_START:
+            if(e != NULL) {
+                Emitter_Start(e);
+            } else {
+                ParticleSystem_Start(ps);
+            }
+            break;
+        case PARTICLE_COMMAND_STOP:
+            if(e != NULL) {
+                Emitter_Stop(e);
+            } else {
+                ParticleSystem_Stop(ps);
+            }
+            break;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+// Snapshots.
+//----------------------------------------------------------------------------------
+
+// ParticleSnapshot_Capture copies position, scale, rotation and color of all live
+// particles of ps into s, reusing its memory. Returns false if there is not enough memory.
+bool ParticleSnapshot_Capture(ParticleSnapshot *s, ParticleSystem *ps) {
+    unsigned int total = 0;
+    for(unsigned int i = 0; i < ps->length; i++) {
+        total += Emitter_LiveCount(ps->emitters[i]);
+    }
+
+    if(total > s->capacity) {
+        ParticleInstance *particles = PARTIKEL_REALLOC(s->particles, total * sizeof(ParticleInstance));
+        if(particles == NULL) {
+            return false;
+        }
+        s->particles = particles;
+        s->capacity = total;
+    }
+    if(ps->length > s->emitterCapacity) {
+        SnapshotEmitter *emitters = PARTIKEL_REALLOC(s->emitters, ps->length * sizeof(SnapshotEmitter));
+        if(emitters == NULL) {
+            return false;
+        }
+        s->emitters = emitters;
+        s->emitterCapacity = ps->length;
+    }
+
+    s->length = 0;
+    for(unsigned int i = 0; i < ps->length; i++) {
+        Emitter *e = ps->emitters[i];
+        unsigned int count = Emitter_LiveCount(e);
+
+        GatherInstances(e, 0, count, s->particles + s->length);
+        s->emitters[i] = (SnapshotEmitter){.emitter = e, .first = s->length, .count = count};
+        s->length += count;
+    }
+    s->emitterLength = ps->length;
+
+    return true;
+}
+
+#ifndef PARTIKEL_NO_RAYLIB
+
+// ParticleSnapshot_Draw draws a captured snapshot. Emitters using particle_Draw are drawn
+// by the built-in batched renderer, since a snapshot holds no complete particles.
+void ParticleSnapshot_Draw(ParticleSnapshot *s) {
+    for(unsigned int i = 0; i < s->emitterLength; i++) {
+        SnapshotEmitter *se = &s->emitters[i];
+        Emitter *e = se->emitter;
+        ParticleInstance *particles = s->particles + se->first;
+
+        BeginBlendMode(e->config.blendMode);
+        if(e->config.drawMode == PARTICLE_DRAW_INSTANCED && DrawInstances(e, particles, se->count)) {
+            // Done.
+        } else {
+            rlSetTexture(e->config.texture.id);
+            DrawQuads(e->config.texture, e->config.textureOrigin, particles, se->count);
+            rlSetTexture(0);
+        }
+        EndBlendMode();
+    }
+}
+
+#endif // PARTIKEL_NO_RAYLIB
+
+// ParticleSnapshot_Free frees the memory of s, not s itself.
+void ParticleSnapshot_Free(ParticleSnapshot *s) {
+    PARTIKEL_FREE(s->particles);
+    PARTIKEL_FREE(s->emitters);
+    *s = (ParticleSnapshot){0};
+}
+
+// ParticleSimulation updates a ParticleSystem and captures it into one of two snapshots,
+// while the other one is drawn. With PARTIKEL_THREADS the update runs on a worker thread.
+struct ParticleSimulation {
+    ParticleSystem *ps;
+    ParticleSnapshot snapshots[2];
+    unsigned int front;         // Snapshot handed out by the last ParticleSimulation_Swap.
+#ifdef PARTIKEL_THREADS
+    bool posted;                // A step has been started and not been handed out yet.
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t start;       // Signaled when a step is posted or the simulation quits.
+    pthread_cond_t done;        // Signaled when the worker finished a step.
+    bool busy;                  // The worker has not finished the posted step yet.
+    bool quit;
+    float dt;
+#endif
+};
+
+// ParticleSimulation_Step updates the system by dt and captures it into the back snapshot.
+static void ParticleSimulation_Step(ParticleSimulation *sim, float dt) {
+    ParticleSystem_Update(sim->ps, dt);
+    ParticleSnapshot_Capture(&sim->snapshots[sim->front ^ 1], sim->ps);
+}
+
+#ifdef PARTIKEL_THREADS
+
+// ParticleSimulation_Main is the loop of the worker thread.
+static void * ParticleSimulation_Main(void *arg) {
+    ParticleSimulation *sim = arg;
+
+    pthread_mutex_lock(&sim->mutex);
+    for(;;) {
+        while(!sim->quit && !sim->busy) {
+            pthread_cond_wait(&sim->start, &sim->mutex);
+        }
+        if(sim->quit) {
+            break;
+        }
+        float dt = sim->dt;
+        pthread_mutex_unlock(&sim->mutex);
+
+        ParticleSimulation_Step(sim, dt);
+
+        pthread_mutex_lock(&sim->mutex);
+        sim->busy = false;
+        pthread_cond_signal(&sim->done);
+    }
+    pthread_mutex_unlock(&sim->mutex);
+
+    return NULL;
+}
+
+#endif // PARTIKEL_THREADS
+
+// ParticleSimulation_New creates a simulation of ps. Until it is freed, ps must only
+// be updated through ParticleSimulation_Swap. Returns NULL on failure.
+ParticleSimulation * ParticleSimulation_New(ParticleSystem *ps) {
+    ParticleSimulation *sim = PARTIKEL_CALLOC(1, sizeof(ParticleSimulation));
+    if(sim == NULL) {
+        return NULL;
+    }
+    sim->ps = ps;
+
+#ifdef PARTIKEL_THREADS
+    pthread_mutex_init(&sim->mutex, NULL);
+    pthread_cond_init(&sim->start, NULL);
+    pthread_cond_init(&sim->done, NULL);
+    if(pthread_create(&sim->thread, NULL, ParticleSimulation_Main, sim) != 0) {
+        pthread_cond_destroy(&sim->done);
+        pthread_cond_destroy(&sim->start);
+        pthread_mutex_destroy(&sim->mutex);
+        PARTIKEL_FREE(sim);
+        return NULL;
+    }
+#endif
+
+    return sim;
+}
+
+// ParticleSimulation_Swap hands out the latest finished snapshot and starts the next step
+// of dt seconds into the other one. The snapshot stays valid until the next call.
+// With PARTIKEL_THREADS the step runs while the caller draws, so the returned snapshot
+// lags one step behind. Otherwise the step runs right away and is returned.
+ParticleSnapshot * ParticleSimulation_Swap(ParticleSimulation *sim, float dt) {
+#ifdef PARTIKEL_THREADS
+    pthread_mutex_lock(&sim->mutex);
+    while(sim->busy) {
+        pthread_cond_wait(&sim->done, &sim->mutex);
+    }
+    if(sim->posted) {
+        sim->front ^= 1;
+    }
+    sim->dt = dt;
+    sim->busy = true;
+    sim->posted = true;
+    pthread_cond_signal(&sim->start);
+    pthread_mutex_unlock(&sim->mutex);
+#else
+    ParticleSimulation_Step(sim, dt);
+    sim->front ^= 1;
+#endif
+
+    return &sim->snapshots[sim->front];
+}
+
+// ParticleSimulation_Free waits for the running step, stops the worker and frees sim.
+// The ParticleSystem is not freed.
+void ParticleSimulation_Free(ParticleSimulation *sim) {
+    if(sim == NULL) {
+        return;
+    }
+
+#ifdef PARTIKEL_THREADS
+    pthread_mutex_lock(&sim->mutex);
+    while(sim->busy) {
+        pthread_cond_wait(&sim->done, &sim->mutex);
+    }
+    sim->quit = true;
+    pthread_cond_signal(&sim->start);
+    pthread_mutex_unlock(&sim->mutex);
+
+    pthread_join(sim->thread, NULL);
+    pthread_cond_destroy(&sim->done);
+    pthread_cond_destroy(&sim->start);
+    pthread_mutex_destroy(&sim->mutex);
+#endif
+
+    ParticleSnapshot_Free(&sim->snapshots[0]);
+    ParticleSnapshot_Free(&sim->snapshots[1]);
+    PARTIKEL_FREE(sim);
+}
+
+// Binary effect files.
+//----------------------------------------------------------------------------------
+
+#include "stdarg.h"
+#include "stdio.h"
+#include "string.h"
+
+#if !defined(PARTIKEL_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define PARTIKEL_MMAP
+#include "fcntl.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
+#include "unistd.h"
+#endif
+
+#define PARTIKEL_EFFECT_MAGIC "PTKL"
+#define PARTIKEL_EFFECT_VERSION 1
+#define PARTIKEL_EFFECT_BYTE_ORDER 0x01020304u
+#define PARTIKEL_EFFECT_NO_STRING 0xFFFFFFFFu
+
+// EffectHeader starts every binary effect file. It is followed by emitterCount
+// EffectRecords of recordSize bytes each, then the string table.
+// Values are stored in the byte order of the saving machine, loaders reject files whose
+// byteOrder differs from theirs. Fields are 32 bit values or arrays of four 8 bit color
+// channels, so the layout has no padding.
+typedef struct EffectHeader {
+    char magic[4];              // PARTIKEL_EFFECT_MAGIC
+    uint32_t version;           // PARTIKEL_EFFECT_VERSION
+    uint32_t byteOrder;         // PARTIKEL_EFFECT_BYTE_ORDER as written by the saving machine.
+    uint32_t emitterCount;
+    uint32_t recordSize;        // sizeof(EffectRecord) when written.
+    uint32_t stringsOffset;     // Offset of the string table from the start of the file.
+    uint32_t stringsSize;
+} EffectHeader;
+
+// EffectRecord holds one EmitterConfig with a fixed layout.
+typedef struct EffectRecord {
+    uint32_t isActive;
+    float direction[2];
+    float velocity[2];
+    float directionAngle[2];
+    float velocityAngle[2];
+    float offset[2];
+    float originAcceleration[2];
+    int32_t burst[2];
+    uint32_t capacity;
+    uint32_t emissionRate;
+    float origin[2];
+    float externalAcceleration[2];
+    float baseScale[2];
+    float baseRotation;
+    float scaleIncrease[2];
+    uint8_t startColor[4];
+    uint8_t endColor[4];
+    float age[2];
+    int32_t blendMode;
+    float rotationSpeed[2];
+    float textureOrigin[2];
+    int32_t drawMode;
+    uint32_t seed;
+    uint32_t texturePath;       // Offset into the string table or PARTIKEL_EFFECT_NO_STRING.
+    uint32_t curveCounts[4];    // Keys of colorOverLife, alphaOverLife, scaleOverLife, dampingOverLife.
+    float colorTimes[PARTIKEL_MAX_KEYS];
+    uint8_t colors[PARTIKEL_MAX_KEYS][4];
+    float floatKeys[3][PARTIKEL_MAX_KEYS][2];   // Time and value of the three FloatCurves.
+    int32_t motion;
+} EffectRecord;
+
+// EffectRecord_Write stores the config and state of e in r.
+static void EffectRecord_Write(EffectRecord *r, Emitter *e, uint32_t texturePath) {
+    EmitterConfig *cfg = &e->config;
+    FloatCurve *curves[3] = {&cfg->alphaOverLife, &cfg->scaleOverLife, &cfg->dampingOverLife};
+
+    *r = (EffectRecord){
+        .isActive = e->isActive,
+        .direction = {cfg->direction.x, cfg->direction.y},
+        .velocity = {cfg->velocity.min, cfg->velocity.max},
+        .directionAngle = {cfg->directionAngle.min, cfg->directionAngle.max},
+        .velocityAngle = {cfg->velocityAngle.min, cfg->velocityAngle.max},
+        .offset = {cfg->offset.min, cfg->offset.max},
+        .originAcceleration = {cfg->originAcceleration.min, cfg->originAcceleration.max},
+        .burst = {cfg->burst.min, cfg->burst.max},
+        .capacity = cfg->capacity,
+        .emissionRate = cfg->emissionRate,
+        .origin = {cfg->origin.x, cfg->origin.y},
+        .externalAcceleration = {cfg->externalAcceleration.x, cfg->externalAcceleration.y},
+        .baseScale = {cfg->baseScale.x, cfg->baseScale.y},
+        .baseRotation = cfg->baseRotation,
+        .scaleIncrease = {cfg->scaleIncrease.x, cfg->scaleIncrease.y},
+        .startColor = {cfg->startColor.r, cfg->startColor.g, cfg->startColor.b, cfg->startColor.a},
+        .endColor = {cfg->endColor.r, cfg->endColor.g, cfg->endColor.b, cfg->endColor.a},
+        .age = {cfg->age.min, cfg->age.max},
+        .blendMode = (int32_t)cfg->blendMode,
+        .rotationSpeed = {cfg->rotationSpeed.min, cfg->rotationSpeed.max},
+        .textureOrigin = {cfg->textureOrigin.x, cfg->textureOrigin.y},
+        .drawMode = (int32_t)cfg->drawMode,
+        .motion = (int32_t)cfg->motion,
+        .seed = cfg->seed,
+        .texturePath = texturePath,
+        .curveCounts = {cfg->colorOverLife.count, cfg->alphaOverLife.count,
+                        cfg->scaleOverLife.count, cfg->dampingOverLife.count}
+    };
+
+    for(unsigned int k = 0; k < PARTIKEL_MAX_KEYS; k++) {
+        ColorKey *key = &cfg->colorOverLife.keys[k];
+        r->colorTimes[k] = key->time;
+        r->colors[k][0] = key->color.r;
+        r->colors[k][1] = key->color.g;
+        r->colors[k][2] = key->color.b;
+        r->colors[k][3] = key->color.a;
+        for(unsigned int c = 0; c < 3; c++) {
+            r->floatKeys[c][k][0] = curves[c]->keys[k].time;
+            r->floatKeys[c][k][1] = curves[c]->keys[k].value;
+        }
+    }
+}
+
+// EffectRecord_Read fills cfg from r. The texture is left to the caller.
+static void EffectRecord_Read(const EffectRecord *r, EmitterConfig *cfg) {
+    FloatCurve *curves[3] = {&cfg->alphaOverLife, &cfg->scaleOverLife, &cfg->dampingOverLife};
+
+    *cfg = (EmitterConfig){
+        .direction = (Vector2){r->direction[0], r->direction[1]},
+        .velocity = (FloatRange){r->velocity[0], r->velocity[1]},
+        .directionAngle = (FloatRange){r->directionAngle[0], r->directionAngle[1]},
+        .velocityAngle = (FloatRange){r->velocityAngle[0], r->velocityAngle[1]},
+        .offset = (FloatRange){r->offset[0], r->offset[1]},
+        .originAcceleration = (FloatRange){r->originAcceleration[0], r->originAcceleration[1]},
+        .burst = (IntRange){r->burst[0], r->burst[1]},
+        .capacity = r->capacity,
+        .emissionRate = r->emissionRate,
+        .origin = (Vector2){r->origin[0], r->origin[1]},
+        .externalAcceleration = (Vector2){r->externalAcceleration[0], r->externalAcceleration[1]},
+        .baseScale = (Vector2){r->baseScale[0], r->baseScale[1]},
+        .baseRotation = r->baseRotation,
+        .scaleIncrease = (Vector2){r->scaleIncrease[0], r->scaleIncrease[1]},
+        .startColor = (Color){r->startColor[0], r->startColor[1], r->startColor[2], r->startColor[3]},
+        .endColor = (Color){r->endColor[0], r->endColor[1], r->endColor[2], r->endColor[3]},
+        .age = (FloatRange){r->age[0], r->age[1]},
+        .blendMode = (BlendMode)r->blendMode,
+        .rotationSpeed = (FloatRange){r->rotationSpeed[0], r->rotationSpeed[1]},
+        .textureOrigin = (Vector2){r->textureOrigin[0], r->textureOrigin[1]},
+        .drawMode = (ParticleDrawMode)r->drawMode,
+        .motion = (ParticleMotion)r->motion,
+        .seed = r->seed
+    };
+
+    cfg->colorOverLife.count = r->curveCounts[0] < PARTIKEL_MAX_KEYS ? r->curveCounts[0] : PARTIKEL_MAX_KEYS;
+    for(unsigned int c = 0; c < 3; c++) {
+        curves[c]->count = r->curveCounts[c+1] < PARTIKEL_MAX_KEYS ? r->curveCounts[c+1] : PARTIKEL_MAX_KEYS;
+    }
+    for(unsigned int k = 0; k < PARTIKEL_MAX_KEYS; k++) {
+        cfg->colorOverLife.keys[k] = (ColorKey){
+            .time = r->colorTimes[k],
+            .color = (Color){r->colors[k][0], r->colors[k][1], r->colors[k][2], r->colors[k][3]}
+        };
+        for(unsigned int c = 0; c < 3; c++) {
+            curves[c]->keys[k] = (FloatKey){.time = r->floatKeys[c][k][0], .value = r->floatKeys[c][k][1]};
+        }
+    }
+}
+
+// EffectVisitor is handed every EmitterConfig read from an effect, in file order, with
+// the metadata of its Emitter or NULL. Returns false to stop reading.
+typedef bool (*EffectVisitor)(EmitterConfig cfg, bool isActive, const char *metadata, void *ctx);
+
+// ParticleSystem_AddVisited is the EffectVisitor creating an Emitter from cfg and
+// registering it to the ParticleSystem ctx. Returns false on failure.
+static bool ParticleSystem_AddVisited(EmitterConfig cfg, bool isActive, const char *metadata, void *ctx) {
+    ParticleSystem *ps = ctx;
+    Emitter *e = Emitter_New(cfg);
+    if(e == NULL) {
+        return false;
+    }
+    if(!Emitter_SetMetadata(e, metadata) || !ParticleSystem_Register(ps, e)) {
+        Emitter_Free(e);
+        return false;
+    }
+    e->isActive = isActive;
+    return true;
+}
+
+// ReadBinaryEffect hands the config of every record of the binary effect in data to visit.
+// Returns false if data is not a valid effect or visit returned false.
+static bool ReadBinaryEffect(const void *data, size_t size, TextureResolver resolve, void *user, EffectVisitor visit, void *ctx) {
+    const unsigned char *bytes = data;
+    EffectHeader header;
+
+    if(size < sizeof(EffectHeader)) {
+        return false;
+    }
+    memcpy(&header, bytes, sizeof(EffectHeader));
+    if(memcmp(header.magic, PARTIKEL_EFFECT_MAGIC, 4) != 0
+       || header.version != PARTIKEL_EFFECT_VERSION
+       || header.byteOrder != PARTIKEL_EFFECT_BYTE_ORDER
+       || header.recordSize == 0
+       || header.emitterCount > (size - sizeof(EffectHeader)) / header.recordSize
+       || header.stringsOffset > size
+       || header.stringsSize > size - header.stringsOffset) {
+        return false;
+    }
+    const char *strings = (const char *)bytes + header.stringsOffset;
+
+    for(uint32_t i = 0; i < header.emitterCount; i++) {
+        // Records of other sizes are cut off or zero extended.
+        EffectRecord record = {0};
+        size_t recordSize = header.recordSize < sizeof(EffectRecord) ? header.recordSize : sizeof(EffectRecord);
+        memcpy(&record, bytes + sizeof(EffectHeader) + (size_t)i * header.recordSize, recordSize);
+
+        EmitterConfig cfg;
+        EffectRecord_Read(&record, &cfg);
+
+        uint32_t path = record.texturePath;
+        if(path != PARTIKEL_EFFECT_NO_STRING) {
+            if(path >= header.stringsSize || memchr(strings + path, '\0', header.stringsSize - path) == NULL) {
+                return false;
+            }
+            if(resolve != NULL) {
+                cfg.texture = resolve(strings + path, user);
+            }
+        }
+
+        if(!visit(cfg, record.isActive != 0, NULL, ctx)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// ParticleSystem_LoadBinary creates a ParticleSystem with one Emitter per record of the
+// binary effect in data, as written by ParticleSystem_SaveBinary. Records are copied
+// straight into the EmitterConfigs, nothing is parsed. resolve is called for every texture
+// path and may be NULL. Free the result with ParticleSystem_FreeAll.
+// Returns NULL if data is not a valid effect or there is not enough memory. Textures
+// resolved before the failure are not released, see TextureResolver.
+ParticleSystem * ParticleSystem_LoadBinary(const void *data, size_t size, TextureResolver resolve, void *user) {
+    ParticleSystem *ps = ParticleSystem_New();
+    if(ps == NULL) {
+        return NULL;
+    }
+    if(!ReadBinaryEffect(data, size, resolve, user, ParticleSystem_AddVisited, ps)) {
+        ParticleSystem_FreeAll(ps);
+        return NULL;
+    }
+
+    return ps;
+}
+
+// MapFile makes the whole file at path readable in memory. It is memory mapped where
+// possible and read into memory otherwise. Returns NULL if the file can't be read.
+static void * MapFile(const char *path, size_t *size) {
+#ifdef PARTIKEL_MMAP
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    void *data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    return data != MAP_FAILED ? data : NULL;
+#else
+    FILE *f = fopen(path, "rb");
+    if(f == NULL) {
+        return NULL;
+    }
+    long length = -1;
+    if(fseek(f, 0, SEEK_END) == 0) {
+        length = ftell(f);
+    }
+    void *data = length > 0 ? PARTIKEL_CALLOC(1, (size_t)length) : NULL;
+    if(data != NULL && (fseek(f, 0, SEEK_SET) != 0 || fread(data, 1, (size_t)length, f) != (size_t)length)) {
+        PARTIKEL_FREE(data);
+        data = NULL;
+    }
+    fclose(f);
+    *size = (size_t)length;
+
+    return data;
+#endif
+}
+
+// UnmapFile releases memory returned by MapFile.
+static void UnmapFile(void *data, size_t size) {
+#ifdef PARTIKEL_MMAP
+    munmap(data, size);
+#else
+    (void)size;
+    PARTIKEL_FREE(data);
+#endif
+}
+
+// WriteFile writes size bytes of data to the file at path.
+// Returns true on success and false otherwise.
+static bool WriteFile(const char *path, const void *data, size_t size) {
+    FILE *f = fopen(path, "wb");
+    if(f == NULL) {
+        return false;
+    }
+    bool ok = fwrite(data, 1, size, f) == size;
+    return fclose(f) == 0 && ok;
+}
+
+// ParticleSystem_LoadBinaryFile is ParticleSystem_LoadBinary for the file at path.
+// The file is memory mapped where possible and read into memory otherwise.
+ParticleSystem * ParticleSystem_LoadBinaryFile(const char *path, TextureResolver resolve, void *user) {
+    size_t size;
+    void *data = MapFile(path, &size);
+    if(data == NULL) {
+        return NULL;
+    }
+    ParticleSystem *ps = ParticleSystem_LoadBinary(data, size, resolve, user);
+    UnmapFile(data, size);
+
+    return ps;
+}
+
+// ParticleSystem_SaveBinary writes all Emitters of ps as a binary effect into buffer.
+// texturePaths holds the texture path of every Emitter, in registration order. It and
+// its entries may be NULL. Returns the size of the effect; nothing is written if buffer
+// is NULL or smaller than that, so call it with NULL first to get the size.
+size_t ParticleSystem_SaveBinary(ParticleSystem *ps, const char *const *texturePaths, void *buffer, size_t size) {
+    size_t stringsSize = 0;
+    for(unsigned int i = 0; i < ps->length; i++) {
+        if(texturePaths != NULL && texturePaths[i] != NULL) {
+            stringsSize += strlen(texturePaths[i]) + 1;
+        }
+    }
+    size_t stringsOffset = sizeof(EffectHeader) + ps->length * sizeof(EffectRecord);
+    size_t total = stringsOffset + stringsSize;
+    if(buffer == NULL || size < total) {
+        return total;
+    }
+
+    unsigned char *bytes = buffer;
+    EffectHeader header = {
+        .magic = {PARTIKEL_EFFECT_MAGIC[0], PARTIKEL_EFFECT_MAGIC[1], PARTIKEL_EFFECT_MAGIC[2], PARTIKEL_EFFECT_MAGIC[3]},
+        .version = PARTIKEL_EFFECT_VERSION,
+        .byteOrder = PARTIKEL_EFFECT_BYTE_ORDER,
+        .emitterCount = ps->length,
+        .recordSize = sizeof(EffectRecord),
+        .stringsOffset = (uint32_t)stringsOffset,
+        .stringsSize = (uint32_t)stringsSize
+    };
+    memcpy(bytes, &header, sizeof(EffectHeader));
+
+    size_t cursor = 0;
+    for(unsigned int i = 0; i < ps->length; i++) {
+        uint32_t path = PARTIKEL_EFFECT_NO_STRING;
+        if(texturePaths != NULL && texturePaths[i] != NULL) {
+            size_t length = strlen(texturePaths[i]) + 1;
+            memcpy(bytes + stringsOffset + cursor, texturePaths[i], length);
+            path = (uint32_t)cursor;
+            cursor += length;
+        }
+
+        EffectRecord record;
+        EffectRecord_Write(&record, ps->emitters[i], path);
+        memcpy(bytes + sizeof(EffectHeader) + i * sizeof(EffectRecord), &record, sizeof(EffectRecord));
+    }
+
+    return total;
+}
+
+// ParticleSystem_SaveBinaryFile writes ps as a binary effect to the file at path.
+// Returns true on success and false otherwise.
+bool ParticleSystem_SaveBinaryFile(ParticleSystem *ps, const char *const *texturePaths, const char *path) {
+    size_t size = ParticleSystem_SaveBinary(ps, texturePaths, NULL, 0);
+    void *buffer = PARTIKEL_CALLOC(1, size);
+    if(buffer == NULL) {
+        return false;
+    }
+    ParticleSystem_SaveBinary(ps, texturePaths, buffer, size);
+
+    bool ok = WriteFile(path, buffer, size);
+    PARTIKEL_FREE(buffer);
+
+    return ok;
+}
+
+// Text effect files.
+//----------------------------------------------------------------------------------
+
+// Longest texture path the text loader hands to a TextureResolver.
+#define PARTIKEL_MAX_PATH 512
+
+// EffectTokenizer reads a text effect in place, without copying or terminating it.
+typedef struct EffectTokenizer {
+    const char *cursor;
+    const char *end;
+} EffectTokenizer;
+
+// Tokenizer_Accept consumes c if it is the next character. Returns true if it was.
+static bool Tokenizer_Accept(EffectTokenizer *t, char c) {
+    if(t->cursor < t->end && *t->cursor == c) {
+        t->cursor++;
+        return true;
+    }
+    return false;
+}
+
+// Tokenizer_AtLineEnd returns true at the end of a line or of the text.
+static bool Tokenizer_AtLineEnd(EffectTokenizer *t) {
+    return t->cursor >= t->end || *t->cursor == '\n' || *t->cursor == '\r';
+}
+
+// Tokenizer_NextLine skips the rest of the current line.
+static void Tokenizer_NextLine(EffectTokenizer *t) {
+    while(t->cursor < t->end && *t->cursor != '\n') {
+        t->cursor++;
+    }
+    Tokenizer_Accept(t, '\n');
+}
+
+// Tokenizer_Field returns the text up to the next '|' or line end and skips it.
+static const char * Tokenizer_Field(EffectTokenizer *t, size_t *length) {
+    const char *start = t->cursor;
+    while(!Tokenizer_AtLineEnd(t) && *t->cursor != '|') {
+        t->cursor++;
+    }
+    *length = (size_t)(t->cursor - start);
+    return start;
+}
+
+// Tokenizer_Float reads a decimal number like "-12.5" or "1e-3".
+// Returns false if there is none.
+static bool Tokenizer_Float(EffectTokenizer *t, float *value) {
+    const char *p = t->cursor;
+    const char *end = t->end;
+    double mantissa = 0;
+    int exponent = 0;
+    bool negative = false;
+    bool digits = false;
+
+    while(p < end && *p == ' ') {
+        p++;
+    }
+    if(p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    for(; p < end && *p >= '0' && *p <= '9'; p++) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits = true;
+    }
+    if(p < end && *p == '.') {
+        for(p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            mantissa = mantissa * 10 + (*p - '0');
+            exponent--;
+            digits = true;
+        }
+    }
+    if(!digits) {
+        return false;
+    }
+    if(p + 1 < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool negativeExponent = false;
+        int e = 0;
+        if(*q == '-' || *q == '+') {
+            negativeExponent = *q == '-';
+            q++;
+        }
+        if(q < end && *q >= '0' && *q <= '9') {
+            for(; q < end && *q >= '0' && *q <= '9'; q++) {
+                e = e < 1000 ? e * 10 + (*q - '0') : e;
+            }
+            exponent += negativeExponent ? -e : e;
+            p = q;
+        }
+    }
+
+    t->cursor = p;
+    *value = (float)((negative ? -mantissa : mantissa) * pow(10.0, exponent));
+    return true;
+}
+
+// Tokenizer_Int reads an integer. Returns false if there is none.
+static bool Tokenizer_Int(EffectTokenizer *t, long *value) {
+    float f;
+    const char *start = t->cursor;
+    if(!Tokenizer_Float(t, &f)) {
+        return false;
+    }
+    // Whole numbers only, without the rounding of a float.
+    long v = 0;
+    bool negative = false;
+    const char *p = start;
+    while(*p == ' ') {
+        p++;
+    }
+    if(*p == '-' || *p == '+') {
+        negative = *p == '-';
+        p++;
+    }
+    for(; p < t->cursor && *p >= '0' && *p <= '9'; p++) {
+        v = v < 1000000000000L ? v * 10 + (*p - '0') : v;
+    }
+    if(p != t->cursor) {
+        return false;
+    }
+    *value = negative ? -v : v;
+    return true;
+}
+
+// Tokenizer_Floats reads count comma separated numbers.
+static bool Tokenizer_Floats(EffectTokenizer *t, float *values, unsigned int count) {
+    for(unsigned int i = 0; i < count; i++) {
+        if((i > 0 && !Tokenizer_Accept(t, ',')) || !Tokenizer_Float(t, &values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Tokenizer_Ints reads count comma separated integers.
+static bool Tokenizer_Ints(EffectTokenizer *t, long *values, unsigned int count) {
+    for(unsigned int i = 0; i < count; i++) {
+        if((i > 0 && !Tokenizer_Accept(t, ',')) || !Tokenizer_Int(t, &values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Tokenizer_Color reads "r,g,b,a".
+static bool Tokenizer_Color(EffectTokenizer *t, Color *color) {
+    long v[4];
+    if(!Tokenizer_Ints(t, v, 4)) {
+        return false;
+    }
+    *color = (Color){(unsigned char)v[0], (unsigned char)v[1], (unsigned char)v[2], (unsigned char)v[3]};
+    return true;
+}
+
+// Tokenizer_FloatCurve reads keys written as "time,value;time,value".
+static bool Tokenizer_FloatCurve(EffectTokenizer *t, FloatCurve *curve) {
+    curve->count = 0;
+    do {
+        float v[2];
+        if(curve->count >= PARTIKEL_MAX_KEYS || !Tokenizer_Floats(t, v, 2)) {
+            return false;
+        }
+        curve->keys[curve->count++] = (FloatKey){.time = v[0], .value = v[1]};
+    } while(Tokenizer_Accept(t, ';'));
+    return true;
+}
+
+// Tokenizer_ColorCurve reads keys written as "time,r,g,b,a;time,r,g,b,a".
+static bool Tokenizer_ColorCurve(EffectTokenizer *t, ColorCurve *curve) {
+    curve->count = 0;
+    do {
+        ColorKey key;
+        if(curve->count >= PARTIKEL_MAX_KEYS || !Tokenizer_Float(t, &key.time)
+           || !Tokenizer_Accept(t, ',') || !Tokenizer_Color(t, &key.color)) {
+            return false;
+        }
+        curve->keys[curve->count++] = key;
+    } while(Tokenizer_Accept(t, ';'));
+    return true;
+}
+
+// FieldIs returns true if the field name of the given length equals name.
+static bool FieldIs(const char *field, size_t length, const char *name) {
+    return strlen(name) == length && memcmp(field, name, length) == 0;
+}
+
+// Tokenizer_Option reads one optional "name=value" field into cfg. The still encoded value
+// of a metadata option is returned as a span of the text.
+// Fields without a known name are skipped, e.g. metadata of older editor versions.
+static bool Tokenizer_Option(EffectTokenizer *t, EmitterConfig *cfg, const char **metadata, size_t *metadataLength) {
+    const char *name = t->cursor;
+    while(!Tokenizer_AtLineEnd(t) && *t->cursor != '|' && *t->cursor != '=') {
+        t->cursor++;
+    }
+    size_t length = (size_t)(t->cursor - name);
+    long v;
+    bool ok = true;
+
+    if(!Tokenizer_Accept(t, '=')) {
+        // Not an option.
+    } else if(FieldIs(name, length, "emissionRate")) {
+        ok = Tokenizer_Int(t, &v) && v >= 0;
+        cfg->emissionRate = (unsigned int)v;
+    } else if(FieldIs(name, length, "blendMode")) {
+        ok = Tokenizer_Int(t, &v);
+        cfg->blendMode = (BlendMode)v;
+    } else if(FieldIs(name, length, "drawMode")) {
+        ok = Tokenizer_Int(t, &v);
+        cfg->drawMode = (ParticleDrawMode)v;
+    } else if(FieldIs(name, length, "motion")) {
+        ok = Tokenizer_Int(t, &v);
+        cfg->motion = (ParticleMotion)v;
+    } else if(FieldIs(name, length, "seed")) {
+        ok = Tokenizer_Int(t, &v) && v >= 0;
+        cfg->seed = (unsigned int)v;
+    } else if(FieldIs(name, length, "colorOverLife")) {
+        ok = Tokenizer_ColorCurve(t, &cfg->colorOverLife);
+    } else if(FieldIs(name, length, "alphaOverLife")) {
+        ok = Tokenizer_FloatCurve(t, &cfg->alphaOverLife);
+    } else if(FieldIs(name, length, "scaleOverLife")) {
+        ok = Tokenizer_FloatCurve(t, &cfg->scaleOverLife);
+    } else if(FieldIs(name, length, "dampingOverLife")) {
+        ok = Tokenizer_FloatCurve(t, &cfg->dampingOverLife);
+    } else if(FieldIs(name, length, "metadata")) {
+        *metadata = Tokenizer_Field(t, metadataLength);
+        return true;
+    }
+
+    // Skip whatever is left of the field.
+    Tokenizer_Field(t, &length);
+    return ok;
+}
+
+// Tokenizer_Emitter reads one Emitter line, see ParticleSystem_Save for its layout.
+// The texture path and the encoded metadata are returned as spans of the text,
+// metadata is NULL if there is none.
+static bool Tokenizer_Emitter(EffectTokenizer *t, EmitterConfig *cfg, bool *isActive, const char **path, size_t *pathLength,
+                              const char **metadata, size_t *metadataLength) {
+    float v[2];
+    long n[2];
+    FloatRange *ranges[] = {&cfg->velocity, &cfg->directionAngle, &cfg->velocityAngle, &cfg->offset, &cfg->originAcceleration};
+    Vector2 *vectors[] = {&cfg->origin, &cfg->externalAcceleration, &cfg->baseScale, &cfg->scaleIncrease};
+
+    *cfg = (EmitterConfig){0};
+    *metadata = NULL;
+
+    if(!Tokenizer_Int(t, &n[0]) || !Tokenizer_Accept(t, '|')) {
+        return false;
+    }
+    *isActive = n[0] != 0;
+
+    if(!Tokenizer_Floats(t, v, 2) || !Tokenizer_Accept(t, '|')) {
+        return false;
+    }
+    cfg->direction = (Vector2){v[0], v[1]};
+
+    for(unsigned int i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        if(!Tokenizer_Floats(t, v, 2) || !Tokenizer_Accept(t, '|')) {
+            return false;
+        }
+        *ranges[i] = (FloatRange){v[0], v[1]};
+    }
+
+    if(!Tokenizer_Ints(t, n, 2) || !Tokenizer_Accept(t, '|')) {
+        return false;
+    }
+    cfg->burst = (IntRange){(int)n[0], (int)n[1]};
+
+    if(!Tokenizer_Int(t, &n[0]) || n[0] < 0 || !Tokenizer_Accept(t, '|')) {
+        return false;
+    }
+    cfg->capacity = (unsigned int)n[0];
+
+    for(unsigned int i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        if(!Tokenizer_Floats(t, v, 2) || !Tokenizer_Accept(t, '|')) {
+            return false;
+        }
+        *vectors[i] = (Vector2){v[0], v[1]};
+    }
+
+    if(!Tokenizer_Color(t, &cfg->startColor) || !Tokenizer_Accept(t, '|')
+       || !Tokenizer_Color(t, &cfg->endColor) || !Tokenizer_Accept(t, '|')) {
+        return false;
+    }
+
+    if(!Tokenizer_Floats(t, v, 2) || !Tokenizer_Accept(t, '|')) {
+        return false;
+    }
+    cfg->age = (FloatRange){v[0], v[1]};
+
+    if(!Tokenizer_Float(t, &cfg->baseRotation) || !Tokenizer_Accept(t, '|')) {
+        return false;
+    }
+
+    if(!Tokenizer_Floats(t, v, 2) || !Tokenizer_Accept(t, '|')) {
+        return false;
+    }
+    cfg->rotationSpeed = (FloatRange){v[0], v[1]};
+
+    if(!Tokenizer_Floats(t, v, 2) || !Tokenizer_Accept(t, '|')) {
+        return false;
+    }
+    cfg->textureOrigin = (Vector2){v[0], v[1]};
+
+    *path = Tokenizer_Field(t, pathLength);
+
+    while(Tokenizer_Accept(t, '|')) {
+        if(!Tokenizer_Option(t, cfg, metadata, metadataLength)) {
+            return false;
+        }
+    }
+
+    return Tokenizer_AtLineEnd(t);
+}
+
+// HexDigit returns the value of the hexadecimal digit c, or -1 if c is none.
+static int HexDigit(char c) {
+    if(c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if(c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    if(c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
+
+// DecodeMetadata returns the zero terminated metadata encoded in the length characters
+// at text, see EffectWriter_Metadata. Free the result with PARTIKEL_FREE.
+// Returns NULL on invalid escapes or if there is not enough memory.
+static char * DecodeMetadata(const char *text, size_t length) {
+    char *decoded = PARTIKEL_CALLOC(1, length + 1);
+    if(decoded == NULL) {
+        return NULL;
+    }
+    size_t n = 0;
+    for(size_t i = 0; i < length; i++) {
+        if(text[i] != '%') {
+            decoded[n++] = text[i];
+            continue;
+        }
+        int high = i + 2 < length ? HexDigit(text[i + 1]) : -1;
+        int low = high >= 0 ? HexDigit(text[i + 2]) : -1;
+        if(low < 0 || (high == 0 && low == 0)) {
+            PARTIKEL_FREE(decoded);
+            return NULL;
+        }
+        decoded[n++] = (char)(high * 16 + low);
+        i += 2;
+    }
+
+    return decoded;
+}
+
+// ReadTextEffect hands the config of every line of the text effect in text to visit.
+// Returns false on syntax errors or if visit returned false.
+static bool ReadTextEffect(const char *text, size_t size, TextureResolver resolve, void *user, EffectVisitor visit, void *ctx) {
+    EffectTokenizer t = {.cursor = text, .end = text + size};
+
+    while(t.cursor < t.end) {
+        // Skip comments and empty lines.
+        if(*t.cursor == '#' || Tokenizer_AtLineEnd(&t)) {
+            Tokenizer_NextLine(&t);
+            continue;
+        }
+
+        EmitterConfig cfg;
+        bool isActive;
+        const char *path, *metadata;
+        size_t pathLength, metadataLength;
+        if(!Tokenizer_Emitter(&t, &cfg, &isActive, &path, &pathLength, &metadata, &metadataLength)
+           || pathLength >= PARTIKEL_MAX_PATH) {
+            return false;
+        }
+        Tokenizer_NextLine(&t);
+
+        char *decoded = NULL;
+        if(metadata != NULL && (decoded = DecodeMetadata(metadata, metadataLength)) == NULL) {
+            return false;
+        }
+
+        if(pathLength > 0 && resolve != NULL) {
+            char terminated[PARTIKEL_MAX_PATH];
+            memcpy(terminated, path, pathLength);
+            terminated[pathLength] = '\0';
+            cfg.texture = resolve(terminated, user);
+        }
+
+        bool ok = visit(cfg, isActive, decoded, ctx);
+        if(decoded != NULL) {
+            PARTIKEL_FREE(decoded);
+        }
+        if(!ok) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// ParticleSystem_LoadFromMemory creates a ParticleSystem with one Emitter per line of the
+// text effect in text, as written by ParticleSystem_Save or the editor. The text is read in
+// a single pass and needs no terminating zero. resolve is called for every non-empty
+// texture path and may be NULL. Free the result with ParticleSystem_FreeAll.
+// Returns NULL on syntax errors or if there is not enough memory.
+ParticleSystem * ParticleSystem_LoadFromMemory(const char *text, size_t size, TextureResolver resolve, void *user) {
+    ParticleSystem *ps = ParticleSystem_New();
+    if(ps == NULL) {
+        return NULL;
+    }
+    if(!ReadTextEffect(text, size, resolve, user, ParticleSystem_AddVisited, ps)) {
+        ParticleSystem_FreeAll(ps);
+        return NULL;
+    }
+
+    return ps;
+}
+
+// ParticleSystem_LoadFromFile is ParticleSystem_LoadFromMemory for the file at path.
+ParticleSystem * ParticleSystem_LoadFromFile(const char *path, TextureResolver resolve, void *user) {
+    size_t size;
+    void *data = MapFile(path, &size);
+    if(data == NULL) {
+        return NULL;
+    }
+    ParticleSystem *ps = ParticleSystem_LoadFromMemory(data, size, resolve, user);
+    UnmapFile(data, size);
+
+    return ps;
+}
+
+// EffectWriter appends formatted text to a buffer, counting what does not fit.
+typedef struct EffectWriter {
+    char *buffer;
+    size_t size;
+    size_t length;
+} EffectWriter;
+
+static void EffectWriter_Printf(EffectWriter *w, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    size_t room = w->length < w->size ? w->size - w->length : 0;
+    int n = vsnprintf(room > 0 ? w->buffer + w->length : NULL, room, format, args);
+    va_end(args);
+    if(n > 0) {
+        w->length += (size_t)n;
+    }
+}
+
+static void EffectWriter_FloatCurve(EffectWriter *w, const char *name, FloatCurve *curve) {
+    if(curve->count == 0) {
+        return;
+    }
+    EffectWriter_Printf(w, "|%s=", name);
+    for(unsigned int k = 0; k < curve->count && k < PARTIKEL_MAX_KEYS; k++) {
+        EffectWriter_Printf(w, "%s%.9g,%.9g", k > 0 ? ";" : "", curve->keys[k].time, curve->keys[k].value);
+    }
+}
+
+// EffectWriter_Metadata writes metadata as an option, with '%', '|' and line breaks
+// percent-encoded so it can't end the field or the line.
+static void EffectWriter_Metadata(EffectWriter *w, const char *metadata) {
+    EffectWriter_Printf(w, "|metadata=");
+    while(*metadata != '\0') {
+        size_t plain = strcspn(metadata, "%|\r\n");
+        EffectWriter_Printf(w, "%.*s", (int)plain, metadata);
+        metadata += plain;
+        if(*metadata != '\0') {
+            EffectWriter_Printf(w, "%%%02X", (unsigned char)*metadata);
+            metadata++;
+        }
+    }
+}
+
+// ParticleSystem_Save writes all Emitters of ps as a text effect into buffer, one line
+// per Emitter:
+//     is active | direction | velocity | direction angle | velocity angle | offset |
+//     origin acceleration | burst | capacity | origin | external acceleration | base scale |
+//     scale increase | start color | end color | life time | base rotation | rotation speed |
+//     texture origin | texture path | name=value options
+// texturePaths holds the texture path of every Emitter, in registration order. It and its
+// entries may be NULL, paths must not contain '|' or line breaks. The metadata of an
+// Emitter is written as an option as well, see Emitter_SetMetadata. Like snprintf, returns
+// the length of the whole text and writes as much of it as fits into size bytes.
+size_t ParticleSystem_Save(ParticleSystem *ps, const char *const *texturePaths, char *buffer, size_t size) {
+    EffectWriter w = {.buffer = buffer, .size = size};
+
+    EffectWriter_Printf(&w, "# is active | direction | velocity | direction angle | velocity angle | offset | "
+                            "origin acceleration | burst | capacity | origin | external acceleration | base scale | "
+                            "scale increase | start color | end color | life time | base rotation | rotation speed | "
+                            "texture origin | texture path | options\n");
+
+    for(unsigned int i = 0; i < ps->length; i++) {
+        Emitter *e = ps->emitters[i];
+        EmitterConfig *cfg = &e->config;
+        const char *path = texturePaths != NULL && texturePaths[i] != NULL ? texturePaths[i] : "";
+
+        EffectWriter_Printf(&w, "%d|%.9g,%.9g|%.9g,%.9g|%.9g,%.9g|%.9g,%.9g|%.9g,%.9g|%.9g,%.9g|%d,%d|%u|",
+                            e->isActive, cfg->direction.x, cfg->direction.y,
+                            cfg->velocity.min, cfg->velocity.max,
+                            cfg->directionAngle.min, cfg->directionAngle.max,
+                            cfg->velocityAngle.min, cfg->velocityAngle.max,
+                            cfg->offset.min, cfg->offset.max,
+                            cfg->originAcceleration.min, cfg->originAcceleration.max,
+                            cfg->burst.min, cfg->burst.max, cfg->capacity);
+        EffectWriter_Printf(&w, "%.9g,%.9g|%.9g,%.9g|%.9g,%.9g|%.9g,%.9g|%d,%d,%d,%d|%d,%d,%d,%d|",
+                            cfg->origin.x, cfg->origin.y,
+                            cfg->externalAcceleration.x, cfg->externalAcceleration.y,
+                            cfg->baseScale.x, cfg->baseScale.y,
+                            cfg->scaleIncrease.x, cfg->scaleIncrease.y,
+                            cfg->startColor.r, cfg->startColor.g, cfg->startColor.b, cfg->startColor.a,
+                            cfg->endColor.r, cfg->endColor.g, cfg->endColor.b, cfg->endColor.a);
+        EffectWriter_Printf(&w, "%.9g,%.9g|%.9g|%.9g,%.9g|%.9g,%.9g|%s",
+                            cfg->age.min, cfg->age.max, cfg->baseRotation,
+                            cfg->rotationSpeed.min, cfg->rotationSpeed.max,
+                            cfg->textureOrigin.x, cfg->textureOrigin.y, path);
+        EffectWriter_Printf(&w, "|emissionRate=%u|blendMode=%d|drawMode=%d|seed=%u|motion=%d",
+                            cfg->emissionRate, (int)cfg->blendMode, (int)cfg->drawMode, cfg->seed, (int)cfg->motion);
+
+        if(cfg->colorOverLife.count > 0) {
+            EffectWriter_Printf(&w, "|colorOverLife=");
+            for(unsigned int k = 0; k < cfg->colorOverLife.count && k < PARTIKEL_MAX_KEYS; k++) {
+                ColorKey *key = &cfg->colorOverLife.keys[k];
+                EffectWriter_Printf(&w, "%s%.9g,%d,%d,%d,%d", k > 0 ? ";" : "", key->time,
+                                    key->color.r, key->color.g, key->color.b, key->color.a);
+            }
+        }
+        EffectWriter_FloatCurve(&w, "alphaOverLife", &cfg->alphaOverLife);
+        EffectWriter_FloatCurve(&w, "scaleOverLife", &cfg->scaleOverLife);
+        EffectWriter_FloatCurve(&w, "dampingOverLife", &cfg->dampingOverLife);
+        if(e->metadata != NULL) {
+            EffectWriter_Metadata(&w, e->metadata);
+        }
+        EffectWriter_Printf(&w, "\n");
+    }
+
+    return w.length;
+}
+
+// ParticleSystem_SaveToFile writes ps as a text effect to the file at path.
+// Returns true on success and false otherwise.
+bool ParticleSystem_SaveToFile(ParticleSystem *ps, const char *const *texturePaths, const char *path) {
+    size_t length = ParticleSystem_Save(ps, texturePaths, NULL, 0);
+    char *buffer = PARTIKEL_CALLOC(1, length + 1);
+    if(buffer == NULL) {
+        return false;
+    }
+    ParticleSystem_Save(ps, texturePaths, buffer, length + 1);
+
+    bool ok = WriteFile(path, buffer, length);
+    PARTIKEL_FREE(buffer);
+
+    return ok;
+}
+
+// Emitter_SetMetadata stores a copy of metadata with e, e.g. editor state. The library
+// never interprets it, but text effects save and load it along with the Emitter. Binary
+// effects, templates and snapshots leave it out. NULL or "" removes it.
+// Returns false if there is not enough memory, in which case the old metadata is kept.
+bool Emitter_SetMetadata(Emitter *e, const char *metadata) {
+    char *copy = NULL;
+    if(metadata != NULL && metadata[0] != '\0') {
+        size_t size = strlen(metadata) + 1;
+        copy = PARTIKEL_CALLOC(1, size);
+        if(copy == NULL) {
+            return false;
+        }
+        memcpy(copy, metadata, size);
+    }
+    if(e->metadata != NULL) {
+        PARTIKEL_FREE(e->metadata);
+    }
+    e->metadata = copy;
+
+    return true;
+}
+
+// Effect templates.
+//----------------------------------------------------------------------------------
+
+// EffectTemplate_Alloc allocates a template for n Emitters as a single block holding the
+// template, its configs and their ParticleLUTs. Returns NULL if there is not enough memory.
+static EffectTemplate * EffectTemplate_Alloc(unsigned int n) {
+    size_t header = PARTIKEL_ALIGN_UP(sizeof(EffectTemplate));
+    size_t luts = PARTIKEL_ALIGN_UP(sizeof(ParticleLUT)) * n;
+    size_t configs = PARTIKEL_ALIGN_UP(sizeof(EmitterConfig) * n);
+    void *block = PARTIKEL_CALLOC(1, header + luts + configs + n + PARTIKEL_ALIGNMENT - 1);
+    if(block == NULL) {
+        return NULL;
+    }
+
+    unsigned char *base = AlignPointer(block);
+    EffectTemplate *t = (EffectTemplate *)base;
+    t->block = block;
+    t->length = n;
+    t->luts = (ParticleLUT *)(base + header);
+    t->configs = (EmitterConfig *)(base + header + luts);
+    t->isActive = (bool *)(base + header + luts + configs);
+
+    return t;
+}
+
+// EffectTemplate_Bake prepares the configs of t like Emitter_New does and bakes their ParticleLUTs.
+static void EffectTemplate_Bake(EffectTemplate *t) {
+    for(unsigned int i = 0; i < t->length; i++) {
+        t->configs[i].direction = NormalizeV2(t->configs[i].direction);
+        ParticleLUT_Bake(&t->luts[i], &t->configs[i]);
+    }
+}
+
+// EffectTemplate_New creates a template from the current configs of all Emitters of ps,
+// e.g. an effect loaded with ParticleSystem_LoadFromFile. The configs, their ParticleLUTs
+// and the template are allocated as a single block. ps is not needed afterwards.
+// Returns NULL if there is not enough memory.
+EffectTemplate * EffectTemplate_New(ParticleSystem *ps) {
+    EffectTemplate *t = EffectTemplate_Alloc(ps->length);
+    if(t == NULL) {
+        return NULL;
+    }
+    for(unsigned int i = 0; i < ps->length; i++) {
+        t->configs[i] = ps->emitters[i]->config;
+        t->isActive[i] = ps->emitters[i]->isActive;
+    }
+    EffectTemplate_Bake(t);
+
+    return t;
+}
+
+// EffectTemplate_Free frees t. All of its instances must be freed before.
+void EffectTemplate_Free(EffectTemplate *t) {
+    PARTIKEL_FREE(t->block);
+}
+
+// ParticleSystem_Instantiate creates a ParticleSystem at origin with one Emitter per config
+// of t. The Emitters read the ParticleLUTs of t instead of baking their own, so only their
+// particle state is allocated. Nonzero seeds are mixed with the number of the instance, so
+// instances differ from each other but the n-th instance of a template is always the same.
+// Free the result with ParticleSystem_FreeAll. Returns NULL if there is not enough memory.
+ParticleSystem * ParticleSystem_Instantiate(EffectTemplate *t, Vector2 origin) {
+    ParticleSystem *ps = ParticleSystem_New();
+    if(ps == NULL) {
+        return NULL;
+    }
+
+    for(unsigned int i = 0; i < t->length; i++) {
+        EmitterConfig cfg = t->configs[i];
+        if(cfg.seed != 0) {
+            // The first instance keeps the seed of the file. 0 would pick a random seed.
+            cfg.seed ^= t->instances * 0x9E3779B9u;
+            if(cfg.seed == 0) {
+                cfg.seed = 0x9E3779B9u;
+            }
+        }
+        Emitter *e = Emitter_Create(cfg, &t->luts[i]);
+        if(e == NULL || !ParticleSystem_Register(ps, e)) {
+            if(e != NULL) {
+                Emitter_Free(e);
+            }
+            ParticleSystem_FreeAll(ps);
+            return NULL;
+        }
+        e->isActive = t->isActive[i];
+    }
+    ParticleSystem_SetOrigin(ps, origin);
+    t->instances++;
+
+    return ps;
+}
+
+// RegistryEntry maps a path to a loaded template or texture.
+typedef struct RegistryEntry {
+    char *path;
+    EffectTemplate *effect;
+    Texture2D texture;
+} RegistryEntry;
+
+// EffectRegistry loads every effect file and every texture only once.
+struct EffectRegistry {
+    TextureResolver resolve;
+    TextureReleaser release;
+    void *user;
+    RegistryEntry *effects;
+    unsigned int effectLength;
+    unsigned int effectCapacity;
+    RegistryEntry *textures;
+    unsigned int textureLength;
+    unsigned int textureCapacity;
+};
+
+// RegistryEntry_Find returns the entry for path, or NULL.
+static RegistryEntry * RegistryEntry_Find(RegistryEntry *entries, unsigned int length, const char *path) {
+    for(unsigned int i = 0; i < length; i++) {
+        if(strcmp(entries[i].path, path) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+// RegistryEntry_Add appends an entry for a copy of path.
+// Returns NULL if there is not enough memory.
+static RegistryEntry * RegistryEntry_Add(RegistryEntry **entries, unsigned int *length, unsigned int *capacity, const char *path) {
+    // If there is no space for another entry we have to realloc.
+    if(*length >= *capacity) {
+        unsigned int newCapacity = *capacity > 0 ? 2 * *capacity : 8;
+        RegistryEntry *newEntries = PARTIKEL_REALLOC(*entries, newCapacity * sizeof(RegistryEntry));
+        if(newEntries == NULL) {
+            return NULL;
+        }
+        *entries = newEntries;
+        *capacity = newCapacity;
+    }
+
+    size_t size = strlen(path) + 1;
+    char *copy = PARTIKEL_CALLOC(1, size);
+    if(copy == NULL) {
+        return NULL;
+    }
+    memcpy(copy, path, size);
+
+    RegistryEntry *entry = &(*entries)[(*length)++];
+    *entry = (RegistryEntry){.path = copy};
+    return entry;
+}
+
+// EffectRegistry_New creates an empty registry. resolve is called once per distinct
+// texture path and may be NULL. release gives the textures back in EffectRegistry_Free
+// and may be NULL. Returns NULL if there is not enough memory.
+EffectRegistry * EffectRegistry_New(TextureResolver resolve, TextureReleaser release, void *user) {
+    EffectRegistry *r = PARTIKEL_CALLOC(1, sizeof(EffectRegistry));
+    if(r == NULL) {
+        return NULL;
+    }
+    r->resolve = resolve;
+    r->release = release;
+    r->user = user;
+
+    return r;
+}
+
+// EffectRegistry_GetTexture returns the texture for path, resolving it on first use.
+Texture2D EffectRegistry_GetTexture(EffectRegistry *r, const char *path) {
+    RegistryEntry *entry = RegistryEntry_Find(r->textures, r->textureLength, path);
+    if(entry != NULL) {
+        return entry->texture;
+    }
+    if(r->resolve == NULL) {
+        return (Texture2D){0};
+    }
+
+    Texture2D texture = r->resolve(path, r->user);
+    entry = RegistryEntry_Add(&r->textures, &r->textureLength, &r->textureCapacity, path);
+    if(entry == NULL) {
+        // Not cached, give it back rather than leaking it.
+        if(r->release != NULL) {
+            r->release(texture, r->user);
+        }
+        return (Texture2D){0};
+    }
+    entry->texture = texture;
+
+    return texture;
+}
+
+// EffectRegistry_Resolve is the TextureResolver handed to the effect loaders.
+static Texture2D EffectRegistry_Resolve(const char *path, void *user) {
+    return EffectRegistry_GetTexture(user, path);
+}
+
+// ReadEffectFile hands every config of the text or binary effect file at path to visit,
+// telling the formats apart by their header. Returns false if the file can't be read.
+static bool ReadEffectFile(const char *path, TextureResolver resolve, void *user, EffectVisitor visit, void *ctx) {
+    size_t size;
+    void *data = MapFile(path, &size);
+    if(data == NULL) {
+        return false;
+    }
+    bool ok;
+    if(size >= 4 && memcmp(data, PARTIKEL_EFFECT_MAGIC, 4) == 0) {
+        ok = ReadBinaryEffect(data, size, resolve, user, visit, ctx);
+    } else {
+        ok = ReadTextEffect(data, size, resolve, user, visit, ctx);
+    }
+    UnmapFile(data, size);
+
+    return ok;
+}
+
+// EffectConfigs collects the configs read from an effect file.
+typedef struct EffectConfigs {
+    EmitterConfig *configs;
+    bool *isActive;
+    unsigned int length;
+    unsigned int capacity;
+} EffectConfigs;
+
+// EffectConfigs_Add is the EffectVisitor appending cfg to the EffectConfigs ctx.
+// Returns false if there is not enough memory.
+static bool EffectConfigs_Add(EmitterConfig cfg, bool isActive, const char *metadata, void *ctx) {
+    EffectConfigs *c = ctx;
+    (void)metadata;
+    // If there is no space for another config we have to realloc.
+    if(c->length >= c->capacity) {
+        unsigned int newCapacity = c->capacity > 0 ? 2 * c->capacity : 8;
+        EmitterConfig *newConfigs = PARTIKEL_REALLOC(c->configs, newCapacity * sizeof(EmitterConfig));
+        if(newConfigs == NULL) {
+            return false;
+        }
+        c->configs = newConfigs;
+        bool *newActive = PARTIKEL_REALLOC(c->isActive, newCapacity * sizeof(bool));
+        if(newActive == NULL) {
+            return false;
+        }
+        c->isActive = newActive;
+        c->capacity = newCapacity;
+    }
+    c->configs[c->length] = cfg;
+    c->isActive[c->length] = isActive;
+    c->length++;
+    return true;
+}
+
+// EffectConfigs_Free frees the configs collected in c.
+static void EffectConfigs_Free(EffectConfigs *c) {
+    if(c->configs != NULL) {
+        PARTIKEL_FREE(c->configs);
+    }
+    if(c->isActive != NULL) {
+        PARTIKEL_FREE(c->isActive);
+    }
+}
+
+// EffectTemplate_Load creates a template straight from the configs of the effect file at
+// path, without creating any Emitters. Returns NULL if the file can't be loaded.
+static EffectTemplate * EffectTemplate_Load(const char *path, TextureResolver resolve, void *user) {
+    EffectConfigs c = {0};
+    EffectTemplate *t = NULL;
+    if(ReadEffectFile(path, resolve, user, EffectConfigs_Add, &c)) {
+        t = EffectTemplate_Alloc(c.length);
+    }
+    if(t != NULL) {
+        for(unsigned int i = 0; i < c.length; i++) {
+            t->configs[i] = c.configs[i];
+            t->isActive[i] = c.isActive[i];
+        }
+        EffectTemplate_Bake(t);
+    }
+    EffectConfigs_Free(&c);
+    return t;
+}
+
+// EffectRegistry_Load returns the template for the effect file at path, loading it on first
+// use. Text and binary effects are told apart by their header. The template is owned by r.
+// Returns NULL if the file can't be loaded.
+EffectTemplate * EffectRegistry_Load(EffectRegistry *r, const char *path) {
+    RegistryEntry *entry = RegistryEntry_Find(r->effects, r->effectLength, path);
+    if(entry != NULL) {
+        return entry->effect;
+    }
+
+    EffectTemplate *t = EffectTemplate_Load(path, EffectRegistry_Resolve, r);
+    if(t == NULL) {
+        return NULL;
+    }
+    entry = RegistryEntry_Add(&r->effects, &r->effectLength, &r->effectCapacity, path);
+    if(entry == NULL) {
+        EffectTemplate_Free(t);
+        return NULL;
+    }
+    entry->effect = t;
+
+    return t;
+}
+
+// EffectRegistry_Free frees r and all of its templates and releases all textures.
+// All instances of its templates must be freed before.
+void EffectRegistry_Free(EffectRegistry *r) {
+    for(unsigned int i = 0; i < r->effectLength; i++) {
+        EffectTemplate_Free(r->effects[i].effect);
+        PARTIKEL_FREE(r->effects[i].path);
+    }
+    for(unsigned int i = 0; i < r->textureLength; i++) {
+        if(r->release != NULL) {
+            r->release(r->textures[i].texture, r->user);
+        }
+        PARTIKEL_FREE(r->textures[i].path);
+    }
+    if(r->effects != NULL) {
+        PARTIKEL_FREE(r->effects);
+    }
+    if(r->textures != NULL) {
+        PARTIKEL_FREE(r->textures);
+    }
+    PARTIKEL_FREE(r);
+}
+
+// Effect hot reloading.
+//----------------------------------------------------------------------------------
+
+#include "sys/stat.h"
+
+#if !defined(PARTIKEL_NO_INOTIFY) && defined(__linux__)
+#define PARTIKEL_INOTIFY
+#include "sys/inotify.h"
+#include "unistd.h"
+#endif
+
+// WatchedEmitter is an Emitter created from one line or record of a watched effect file.
+typedef struct WatchedEmitter {
+    Emitter *emitter;
+    EmitterConfig file;         // Config as last read from the file.
+    bool fileActive;
+    char *texturePath;          // Texture path as last read from the file, or NULL.
+} WatchedEmitter;
+
+// WatchedEffect is a ParticleSystem kept in sync with an effect file.
+typedef struct WatchedEffect {
+    char *path;
+    ParticleSystem *ps;
+    WatchedEmitter *emitters;
+    unsigned int length;
+    bool changed;
+    int wd;                     // inotify watch of the directory of path.
+    struct stat fileStat;       // State of the file when it was last read, for polling.
+} WatchedEffect;
+
+// EffectWatcher reloads the effect files of ParticleSystems when they change on disk.
+struct EffectWatcher {
+    TextureResolver resolve;
+    TextureReleaser release;
+    void *user;
+    int fd;                     // inotify instance, or -1.
+    WatchedEffect *effects;
+    unsigned int length;
+    unsigned int capacity;
+};
+
+// ConfigField is a part of EmitterConfig stored in effect files.
+typedef struct ConfigField {
+    size_t offset;
+    size_t size;
+} ConfigField;
+
+#define PARTIKEL_CONFIG_FIELD(name) {offsetof(EmitterConfig, name), sizeof(((EmitterConfig *)0)->name)}
+
+// Fields compared between reloads, all but the texture which is compared by path.
+static const ConfigField configFields[] = {
+    PARTIKEL_CONFIG_FIELD(direction),
+    PARTIKEL_CONFIG_FIELD(velocity),
+    PARTIKEL_CONFIG_FIELD(directionAngle),
+    PARTIKEL_CONFIG_FIELD(velocityAngle),
+    PARTIKEL_CONFIG_FIELD(offset),
+    PARTIKEL_CONFIG_FIELD(originAcceleration),
+    PARTIKEL_CONFIG_FIELD(burst),
+    PARTIKEL_CONFIG_FIELD(capacity),
+    PARTIKEL_CONFIG_FIELD(emissionRate),
+    PARTIKEL_CONFIG_FIELD(origin),
+    PARTIKEL_CONFIG_FIELD(externalAcceleration),
+    PARTIKEL_CONFIG_FIELD(baseScale),
+    PARTIKEL_CONFIG_FIELD(baseRotation),
+    PARTIKEL_CONFIG_FIELD(scaleIncrease),
+    PARTIKEL_CONFIG_FIELD(startColor),
+    PARTIKEL_CONFIG_FIELD(endColor),
+    PARTIKEL_CONFIG_FIELD(colorOverLife),
+    PARTIKEL_CONFIG_FIELD(alphaOverLife),
+    PARTIKEL_CONFIG_FIELD(scaleOverLife),
+    PARTIKEL_CONFIG_FIELD(dampingOverLife),
+    PARTIKEL_CONFIG_FIELD(age),
+    PARTIKEL_CONFIG_FIELD(blendMode),
+    PARTIKEL_CONFIG_FIELD(rotationSpeed),
+    PARTIKEL_CONFIG_FIELD(textureOrigin),
+    PARTIKEL_CONFIG_FIELD(drawMode),
+    PARTIKEL_CONFIG_FIELD(motion),
+    PARTIKEL_CONFIG_FIELD(seed),
+};
+
+// TexturePaths collects the texture paths of an effect file while it is loaded.
+typedef struct TexturePaths {
+    char **paths;
+    unsigned int length;
+    unsigned int capacity;
+    bool failed;
+} TexturePaths;
+
+// TexturePaths_Record is a TextureResolver which loads nothing. It returns a placeholder
+// texture whose id is the 1-based index of the recorded path.
+static Texture2D TexturePaths_Record(const char *path, void *user) {
+    TexturePaths *tp = user;
+    if(tp->length >= tp->capacity) {
+        unsigned int newCapacity = tp->capacity > 0 ? 2 * tp->capacity : 8;
+        char **newPaths = PARTIKEL_REALLOC(tp->paths, newCapacity * sizeof(char *));
+        if(newPaths == NULL) {
+            tp->failed = true;
+            return (Texture2D){0};
+        }
+        tp->paths = newPaths;
+        tp->capacity = newCapacity;
+    }
+
+    size_t size = strlen(path) + 1;
+    char *copy = PARTIKEL_CALLOC(1, size);
+    if(copy == NULL) {
+        tp->failed = true;
+        return (Texture2D){0};
+    }
+    memcpy(copy, path, size);
+    tp->paths[tp->length++] = copy;
+
+    return (Texture2D){.id = tp->length};
+}
+
+// TexturePaths_Take returns the path recorded for a placeholder texture and removes it
+// from tp, so it is not freed by TexturePaths_Free. Returns NULL for no texture.
+static char * TexturePaths_Take(TexturePaths *tp, Texture2D texture) {
+    if(texture.id == 0 || texture.id > tp->length) {
+        return NULL;
+    }
+    char *path = tp->paths[texture.id - 1];
+    tp->paths[texture.id - 1] = NULL;
+    return path;
+}
+
+static void TexturePaths_Free(TexturePaths *tp) {
+    for(unsigned int i = 0; i < tp->length; i++) {
+        if(tp->paths[i] != NULL) {
+            PARTIKEL_FREE(tp->paths[i]);
+        }
+    }
+    if(tp->paths != NULL) {
+        PARTIKEL_FREE(tp->paths);
+    }
+}
+
+// SamePath compares two texture paths which may be NULL.
+static bool SamePath(const char *a, const char *b) {
+    return (a == NULL && b == NULL) || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+// WatchedEmitter_Apply brings the Emitter of we up to date with src and isActive, freshly read
+// from the file. Only fields which changed in the file are applied, everything else the game
+// changed at runtime (e.g. the origin) is kept. Particles are kept by Emitter_Reinit. created
+// is set for Emitters just created for the file, which take over all of it.
+// path is the texture path of src and is taken over by we.
+static bool WatchedEmitter_Apply(WatchedEmitter *we, EffectWatcher *w, const EmitterConfig *src, bool isActive, char *path, bool created) {
+    EmitterConfig cfg = we->emitter->config;
+    bool changed = false;
+
+    for(unsigned int i = 0; i < sizeof(configFields) / sizeof(configFields[0]); i++) {
+        const ConfigField *f = &configFields[i];
+        const unsigned char *before = (const unsigned char *)&we->file + f->offset;
+        const unsigned char *after = (const unsigned char *)src + f->offset;
+        if(memcmp(before, after, f->size) != 0) {
+            memcpy((unsigned char *)&cfg + f->offset, after, f->size);
+            changed = true;
+        }
+    }
+
+    // Only textures which changed are resolved again.
+    if(!SamePath(we->texturePath, path)) {
+        if(w->release != NULL && cfg.texture.id != 0) {
+            w->release(cfg.texture, w->user);
+        }
+        cfg.texture = path != NULL && w->resolve != NULL ? w->resolve(path, w->user) : (Texture2D){0};
+        changed = true;
+    }
+    if(we->texturePath != NULL) {
+        PARTIKEL_FREE(we->texturePath);
+    }
+    we->texturePath = path;
+
+    if(changed && !Emitter_Reinit(we->emitter, cfg)) {
+        return false;
+    }
+    if(created || isActive != we->fileActive) {
+        we->emitter->isActive = isActive;
+    }
+    we->file = *src;
+    we->fileActive = isActive;
+
+    return true;
+}
+
+// WatchedEffect_Reload reads the file of we again and applies what changed to its
+// ParticleSystem. Emitters added to the file are created and registered, Emitters
+// removed from it are deactivated. Returns false if the file could not be read,
+// e.g. while it is still being written, in which case nothing is changed.
+static bool WatchedEffect_Reload(WatchedEffect *we, EffectWatcher *w) {
+    TexturePaths tp = {0};
+    EffectConfigs c = {0};
+    if(!ReadEffectFile(we->path, TexturePaths_Record, &tp, EffectConfigs_Add, &c) || tp.failed) {
+        EffectConfigs_Free(&c);
+        TexturePaths_Free(&tp);
+        return false;
+    }
+
+    if(c.length > we->length) {
+        WatchedEmitter *newEmitters = PARTIKEL_REALLOC(we->emitters, c.length * sizeof(WatchedEmitter));
+        if(newEmitters == NULL) {
+            EffectConfigs_Free(&c);
+            TexturePaths_Free(&tp);
+            return false;
+        }
+        we->emitters = newEmitters;
+    }
+
+    bool ok = true;
+    for(unsigned int i = 0; i < c.length; i++) {
+        char *path = TexturePaths_Take(&tp, c.configs[i].texture);
+        bool created = i >= we->length;
+
+        if(created) {
+            // A new Emitter, start from the file config with an empty texture path so
+            // WatchedEmitter_Apply resolves its texture.
+            EmitterConfig cfg = c.configs[i];
+            cfg.texture = (Texture2D){0};
+            Emitter *e = Emitter_New(cfg);
+            if(e == NULL || !ParticleSystem_Register(we->ps, e)) {
+                if(e != NULL) {
+                    Emitter_Free(e);
+                }
+                if(path != NULL) {
+                    PARTIKEL_FREE(path);
+                }
+                ok = false;
+                break;
+            }
+            // Join in if the system has been started.
+            e->isEmitting = we->ps->length > 1 && we->ps->emitters[0]->isEmitting;
+            we->emitters[i] = (WatchedEmitter){.emitter = e, .file = cfg};
+            we->length++;
+        }
+
+        ok = WatchedEmitter_Apply(&we->emitters[i], w, &c.configs[i], c.isActive[i], path, created) && ok;
+    }
+    for(unsigned int i = c.length; i < we->length; i++) {
+        we->emitters[i].emitter->isActive = false;
+        we->emitters[i].fileActive = false;
+    }
+
+    EffectConfigs_Free(&c);
+    TexturePaths_Free(&tp);
+
+    return ok;
+}
+
+// EffectWatcher_New creates a watcher without files. resolve is called for textures which
+// changed in a reloaded file, release for textures replaced by them. Both may be NULL.
+// Returns NULL if there is not enough memory.
+EffectWatcher * EffectWatcher_New(TextureResolver resolve, TextureReleaser release, void *user) {
+    EffectWatcher *w = PARTIKEL_CALLOC(1, sizeof(EffectWatcher));
+    if(w == NULL) {
+        return NULL;
+    }
+    w->resolve = resolve;
+    w->release = release;
+    w->user = user;
+    w->fd = -1;
+#ifdef PARTIKEL_INOTIFY
+    w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+
+    return w;
+}
+
+// EffectWatcher_Watch keeps ps in sync with the effect file at path, which ps must have been
+// loaded from, e.g. with ParticleSystem_LoadFromFile. Its Emitters are matched to the file
+// by their order. On Linux the directory of path is watched with inotify, so files replaced
+// by a rename are picked up too. Elsewhere, or with PARTIKEL_NO_INOTIFY, modification
+// times are compared in EffectWatcher_Poll. Returns false if path can't be read.
+bool EffectWatcher_Watch(EffectWatcher *w, ParticleSystem *ps, const char *path) {
+    TexturePaths tp = {0};
+    EffectConfigs c = {0};
+    if(!ReadEffectFile(path, TexturePaths_Record, &tp, EffectConfigs_Add, &c) || tp.failed || c.length > ps->length) {
+        EffectConfigs_Free(&c);
+        TexturePaths_Free(&tp);
+        return false;
+    }
+
+    // If there is no space for another effect we have to realloc.
+    if(w->length >= w->capacity) {
+        unsigned int newCapacity = w->capacity > 0 ? 2 * w->capacity : 4;
+        WatchedEffect *newEffects = PARTIKEL_REALLOC(w->effects, newCapacity * sizeof(WatchedEffect));
+        if(newEffects == NULL) {
+            EffectConfigs_Free(&c);
+            TexturePaths_Free(&tp);
+            return false;
+        }
+        w->effects = newEffects;
+        w->capacity = newCapacity;
+    }
+
+    WatchedEffect *we = &w->effects[w->length];
+    *we = (WatchedEffect){.ps = ps, .wd = -1};
+    size_t size = strlen(path) + 1;
+    we->path = PARTIKEL_CALLOC(1, size);
+    we->emitters = PARTIKEL_CALLOC(c.length > 0 ? c.length : 1, sizeof(WatchedEmitter));
+    if(we->path == NULL || we->emitters == NULL) {
+        if(we->path != NULL) {
+            PARTIKEL_FREE(we->path);
+        }
+        if(we->emitters != NULL) {
+            PARTIKEL_FREE(we->emitters);
+        }
+        EffectConfigs_Free(&c);
+        TexturePaths_Free(&tp);
+        return false;
+    }
+    memcpy(we->path, path, size);
+
+    for(unsigned int i = 0; i < c.length; i++) {
+        we->emitters[i] = (WatchedEmitter){
+            .emitter = ps->emitters[i],
+            .file = c.configs[i],
+            .fileActive = c.isActive[i],
+            .texturePath = TexturePaths_Take(&tp, c.configs[i].texture)
+        };
+    }
+    we->length = c.length;
+    EffectConfigs_Free(&c);
+    TexturePaths_Free(&tp);
+
+    stat(path, &we->fileStat);
+#ifdef PARTIKEL_INOTIFY
+    if(w->fd >= 0) {
+        // Watch the directory, editors often replace files instead of writing them.
+        // Without memory for its path modification times are polled instead.
+        const char *slash = strrchr(path, '/');
+        size_t length = slash == NULL ? 1 : slash == path ? 1 : (size_t)(slash - path);
+        char *dir = PARTIKEL_CALLOC(1, length + 1);
+        if(dir != NULL) {
+            memcpy(dir, slash == NULL ? "." : path, length);
+            we->wd = inotify_add_watch(w->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+            PARTIKEL_FREE(dir);
+        }
+    }
+#endif
+    w->length++;
+
+    return true;
+}
+
+// EffectWatcher_Poll reloads all watched files which changed since the last poll and
+// applies the changes to their ParticleSystems, see WatchedEmitter_Apply. Never blocks,
+// call it once per frame on the thread updating the systems.
+// Returns the amount of ParticleSystems which were updated.
+unsigned int EffectWatcher_Poll(EffectWatcher *w) {
+#ifdef PARTIKEL_INOTIFY
+    if(w->fd >= 0) {
+        char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        ssize_t n;
+        while((n = read(w->fd, buffer, sizeof(buffer))) > 0) {
+            for(char *p = buffer; p < buffer + n; p += sizeof(struct inotify_event) + ((struct inotify_event *)p)->len) {
+                struct inotify_event *event = (struct inotify_event *)p;
+                for(unsigned int i = 0; i < w->length && event->len > 0; i++) {
+                    WatchedEffect *we = &w->effects[i];
+                    const char *slash = strrchr(we->path, '/');
+                    const char *name = slash != NULL ? slash + 1 : we->path;
+                    if(we->wd == event->wd && strcmp(name, event->name) == 0) {
+                        we->changed = true;
+                    }
+                }
+            }
+        }
+    }
+#endif
+
+    unsigned int reloaded = 0;
+    for(unsigned int i = 0; i < w->length; i++) {
+        WatchedEffect *we = &w->effects[i];
+        if(we->wd < 0) {
+            struct stat st;
+            if(stat(we->path, &st) == 0 && (st.st_mtime != we->fileStat.st_mtime || st.st_size != we->fileStat.st_size)) {
+                we->fileStat = st;
+                we->changed = true;
+            }
+        }
+        if(we->changed && WatchedEffect_Reload(we, w)) {
+            we->changed = false;
+            reloaded++;
+        }
+    }
+
+    return reloaded;
+}
+
+// EffectWatcher_Free stops watching all files and frees w. The ParticleSystems and their
+// textures are left as they are.
+void EffectWatcher_Free(EffectWatcher *w) {
+    for(unsigned int i = 0; i < w->length; i++) {
+        WatchedEffect *we = &w->effects[i];
+        for(unsigned int k = 0; k < we->length; k++) {
+            if(we->emitters[k].texturePath != NULL) {
+                PARTIKEL_FREE(we->emitters[k].texturePath);
+            }
+        }
+        PARTIKEL_FREE(we->emitters);
+        PARTIKEL_FREE(we->path);
+    }
+    if(w->effects != NULL) {
+        PARTIKEL_FREE(w->effects);
+    }
+#ifdef PARTIKEL_INOTIFY
+    if(w->fd >= 0) {
+        close(w->fd);
+    }
+#endif
+    PARTIKEL_FREE(w);
+}
+
+// Rollback state.
+//----------------------------------------------------------------------------------
+
+// EmitterState is what Emitter_Snapshot stores in front of the particles of an Emitter.
+// Of the config, only the fields changed by the ParticleSystem setters are kept.
+typedef struct EmitterState {
+    Random random;
+    float mustEmit;
+    float renderLag;
+    unsigned int length;
+    Vector2 origin;
+    FloatRange directionAngle;
+    float baseRotation;
+    bool isEmitting;
+    bool isActive;
+} EmitterState;
+
+// SystemState is what ParticleSystem_Snapshot stores in front of the Emitter states.
+typedef struct SystemState {
+    unsigned int length;
+    float accumulator;
+} SystemState;
+
+// Emitter states are padded to this size, so states of a system can follow each other.
+#define PARTIKEL_STATE_ALIGN(n) (((n) + 7) & ~(size_t)7)
+
+// EmitterState_Size returns the bytes needed to store the state of an Emitter with length particles.
+static size_t EmitterState_Size(unsigned int length) {
+    return PARTIKEL_STATE_ALIGN(sizeof(EmitterState) + PARTIKEL_FLOAT_ARRAYS * (size_t)length * sizeof(float));
+}
+
+// ParticleArrays_Array returns the array at index i in the layout of ParticleArrays_Place.
+static float * ParticleArrays_Array(ParticleArrays *pa, unsigned int i) {
+    return (float *)((unsigned char *)pa->originX + i * PARTIKEL_ALIGN_UP((size_t)pa->capacity * sizeof(float)));
+}
+
+// Emitter_Snapshot stores the live particles of e, its random generator, emission state,
+// render lag and flags into buffer, so Emitter_Restore can rewind e to this point, e.g.
+// for rollback or save games. Unlike ParticleSnapshot it can be restored but not drawn.
+// Dead slots are skipped, each particle array is copied as one contiguous run. Simulating
+// on from a restored state repeats the original run only on the same SimdLevel.
+// Returns the bytes needed and writes only if size is at least that large.
+size_t Emitter_Snapshot(Emitter *e, void *buffer, size_t size) {
+    ParticleArrays *pa = &e->particles;
+    size_t needed = EmitterState_Size(pa->length);
+    if(buffer == NULL || size < needed) {
+        return needed;
+    }
+
+    EmitterState state = {0};
+    state.random = e->random;
+    state.mustEmit = e->mustEmit;
+    state.renderLag = e->renderLag;
+    state.length = pa->length;
+    state.origin = e->config.origin;
+    state.directionAngle = e->config.directionAngle;
+    state.baseRotation = e->config.baseRotation;
+    state.isEmitting = e->isEmitting;
+    state.isActive = e->isActive;
+
+    unsigned char *cursor = buffer;
+    memcpy(cursor, &state, sizeof(EmitterState));
+    cursor += sizeof(EmitterState);
+    for(unsigned int i = 0; i < PARTIKEL_FLOAT_ARRAYS; i++) {
+        memcpy(cursor, ParticleArrays_Array(pa, i), pa->length * sizeof(float));
+        cursor += pa->length * sizeof(float);
+    }
+    memset(cursor, 0, needed - (size_t)(cursor - (unsigned char *)buffer));
+
+    return needed;
+}
+
+// Emitter_Restore rewinds e to a state stored by Emitter_Snapshot. e must have the capacity
+// it had then, anything else in its config is left as it is.
+// Returns the bytes read, or 0 if buffer does not hold a state fitting e.
+size_t Emitter_Restore(Emitter *e, const void *buffer, size_t size) {
+    ParticleArrays *pa = &e->particles;
+    EmitterState state;
+    if(size < sizeof(EmitterState)) {
+        return 0;
+    }
+    memcpy(&state, buffer, sizeof(EmitterState));
+    size_t needed = EmitterState_Size(state.length);
+    if(state.length > pa->capacity || size < needed) {
+        return 0;
+    }
+
+    e->random = state.random;
+    e->mustEmit = state.mustEmit;
+    e->renderLag = state.renderLag;
+    e->config.origin = state.origin;
+    e->config.directionAngle = state.directionAngle;
+    e->config.baseRotation = state.baseRotation;
+    e->isEmitting = state.isEmitting;
+    e->isActive = state.isActive;
+
+    const unsigned char *cursor = (const unsigned char *)buffer + sizeof(EmitterState);
+    for(unsigned int i = 0; i < PARTIKEL_FLOAT_ARRAYS; i++) {
+        memcpy(ParticleArrays_Array(pa, i), cursor, state.length * sizeof(float));
+        cursor += state.length * sizeof(float);
+    }
+    pa->length = state.length;
+
+    return needed;
+}
+
+// ParticleSystem_Snapshot stores the state of all Emitters of ps into buffer, see
+// Emitter_Snapshot, together with the time carried over in fixed step mode.
+// Returns the bytes needed and writes only if size is at least that large.
+size_t ParticleSystem_Snapshot(ParticleSystem *ps, void *buffer, size_t size) {
+    size_t needed = PARTIKEL_STATE_ALIGN(sizeof(SystemState));
+    for(unsigned int i = 0; i < ps->length; i++) {
+        needed += EmitterState_Size(ps->emitters[i]->particles.length);
+    }
+    if(buffer == NULL || size < needed) {
+        return needed;
+    }
+
+    SystemState state = {.length = ps->length, .accumulator = ps->accumulator};
+    unsigned char *cursor = buffer;
+    memset(cursor, 0, PARTIKEL_STATE_ALIGN(sizeof(SystemState)));
+    memcpy(cursor, &state, sizeof(SystemState));
+    cursor += PARTIKEL_STATE_ALIGN(sizeof(SystemState));
+    for(unsigned int i = 0; i < ps->length; i++) {
+        cursor += Emitter_Snapshot(ps->emitters[i], cursor, size - (size_t)(cursor - (unsigned char *)buffer));
+    }
+
+    return needed;
+}
+
+// ParticleSystem_Restore rewinds all Emitters of ps to a state stored by
+// ParticleSystem_Snapshot. ps must have the same Emitters in the same order, and the
+// same fixed step for the following updates to match the ones after the snapshot.
+// Returns false if buffer does not fit ps, Emitters may be partly restored then.
+bool ParticleSystem_Restore(ParticleSystem *ps, const void *buffer, size_t size) {
+    SystemState state;
+    size_t offset = PARTIKEL_STATE_ALIGN(sizeof(SystemState));
+    if(size < offset) {
+        return false;
+    }
+    memcpy(&state, buffer, sizeof(SystemState));
+    if(state.length != ps->length) {
+        return false;
+    }
+    ps->accumulator = state.accumulator;
+
+    const unsigned char *bytes = buffer;
+    for(unsigned int i = 0; i < ps->length; i++) {
+        size_t read = Emitter_Restore(ps->emitters[i], bytes + offset, size - offset);
+        if(read == 0) {
+            return false;
+        }
+        offset += read;
+    }
+
+    return true;
 }
 
 #endif // LIBPARTIKEL_IMPLEMENTATION
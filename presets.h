@@ -0,0 +1,164 @@
+/*******************************************************************************************
+*
+*   libpartikel presets - The effects shown by demo.c and measured by bench.c.
+*
+*   Every Preset function fills cfgs with the Emitters of one effect, without textures,
+*   and returns their amount. Include partikel.h first. The includer defines the deactivators
+*   Particle_DeactivatorFountain and Particle_DeactivatorOutsideCam.
+*
+*   libpartikel is licensed under an unmodified zlib/libpng license (View partikel.h for details)
+*
+********************************************************************************************/
+
+#ifndef PARTIKEL_PRESETS_H
+#define PARTIKEL_PRESETS_H
+
+// Most Emitters of one preset.
+#define PRESET_MAX_EMITTERS 3
+
+bool Particle_DeactivatorFountain(Particle *p);
+bool Particle_DeactivatorOutsideCam(Particle *p);
+
+static unsigned int PresetFountain(EmitterConfig cfgs[PRESET_MAX_EMITTERS]) {
+    EmitterConfig ecfg1 = {
+        .capacity = 600,
+        .emissionRate = 200,
+        .origin = (Vector2){.x = 0, .y = 0},
+        .originAcceleration = (FloatRange){.min = 0, .max = 0},
+        .direction = (Vector2){.x = 0, .y = -1}, // go up
+        .directionAngle = (FloatRange){.min = -6, .max = 6}, // angle range -8 to +8 degree deviation from direction
+        .velocityAngle = (FloatRange){.min = 0, .max = 0},
+        .velocity = (FloatRange){.min = 700, .max = 730},
+        .externalAcceleration = (Vector2){.x = 0, .y = 981},
+        .baseScale = (Vector2){0.2, 0.2},
+        .scaleIncrease = (Vector2){0.8, 0.8},
+        .startColor = (Color){.r = 0, .g = 20, .b = 255, .a = 255},
+        .endColor = (Color){.r = 0, .g = 150, .b = 100, .a = 0},
+        .age = (FloatRange){.min = 1.0, .max = 3.0},
+        .blendMode = BLEND_ADDITIVE,
+
+        .particle_Deactivator = Particle_DeactivatorFountain
+    };
+    cfgs[0] = ecfg1;
+
+    ecfg1.directionAngle = (FloatRange){.min = -1.5, .max = 1.5};
+    ecfg1.velocity = (FloatRange){.min = 800, .max = 850};
+    cfgs[1] = ecfg1;
+
+    ecfg1.capacity = 3000;
+    ecfg1.emissionRate = 1000;
+    ecfg1.directionAngle = (FloatRange){.min = -20, .max = 20};
+    ecfg1.velocity = (FloatRange){.min = 500, .max = 550};
+    ecfg1.age = (FloatRange){.min = 0.0, .max = 3.0};
+    cfgs[2] = ecfg1;
+
+    return 3;
+}
+
+static unsigned int PresetSwirl(EmitterConfig cfgs[PRESET_MAX_EMITTERS]) {
+    EmitterConfig ecfg = {
+        .capacity = 2500,
+        .emissionRate = 500,
+        .origin = (Vector2){.x = 0, .y = 0},
+        .originAcceleration = (FloatRange){.min = 400, .max = 500},
+        .offset = (FloatRange){.min = 30, .max = 40},
+        .direction = (Vector2){.x = 0, .y = -1}, // go up
+        .directionAngle = (FloatRange){.min = -180, .max = 180},
+        .velocityAngle = (FloatRange){.min = 90, .max = 90},
+        .velocity = (FloatRange){.min = 200, .max = 500},
+        .baseScale = (Vector2){0.2, 0.2},
+        .startColor = (Color){.r = 244, .g = 20, .b = 0, .a = 255},
+        .endColor = (Color){.r = 244, .g = 20, .b = 0, .a = 0},
+        .age = (FloatRange){.min = 2.5, .max = 5.0},
+        .blendMode = BLEND_ADDITIVE,
+
+        .particle_Deactivator = Particle_DeactivatorOutsideCam
+    };
+    cfgs[0] = ecfg;
+
+    ecfg.capacity = 1000;
+    ecfg.emissionRate = 200;
+    ecfg.offset = (FloatRange){.min = 40, .max = 50};
+    ecfg.startColor = (Color){.r = 244, .g = 0, .b = 111, .a = 255};
+    ecfg.endColor = (Color){.r = 244, .g = 0, .b = 111, .a = 0};
+    cfgs[1] = ecfg;
+
+    ecfg.capacity = 150;
+    ecfg.emissionRate = 30;
+    ecfg.offset = (FloatRange){.min = 20, .max = 30};
+    ecfg.velocity = (FloatRange){.min = 100, .max = 200};
+    ecfg.startColor = (Color){.r = 255, .g = 211, .b = 0, .a = 255};
+    ecfg.endColor = (Color){.r = 255, .g = 211, .b = 0, .a = 0};
+    cfgs[2] = ecfg;
+
+    return 3;
+}
+
+static unsigned int PresetFlame(EmitterConfig cfgs[PRESET_MAX_EMITTERS]) {
+    EmitterConfig ecfg = {
+        .capacity = 1000,
+        .emissionRate = 500,
+        .origin = (Vector2){.x = 0, .y = 0},
+        .originAcceleration = (FloatRange){.min = 50, .max = 100},
+        .offset = (FloatRange){.min = 0, .max = 10},
+        .direction = (Vector2){.x = 0, .y = -1}, // go up
+        .directionAngle = (FloatRange){.min = -90, .max = -90},
+        .velocityAngle = (FloatRange){.min = 90, .max = 90},
+        .velocity = (FloatRange){.min = 30, .max = 150},
+        .baseScale = (Vector2){0.4, 0.4},
+        .startColor = (Color){.r = 255, .g = 20, .b = 0, .a = 255},
+        .endColor = (Color){.r = 255, .g = 20, .b = 0, .a = 0},
+        .age = (FloatRange){.min = 1.0, .max = 2.0},
+        .blendMode = BLEND_ADDITIVE,
+
+        .particle_Deactivator = Particle_DeactivatorFountain
+    };
+    cfgs[0] = ecfg;
+
+    ecfg.capacity = 20;
+    ecfg.emissionRate = 20;
+    ecfg.startColor = (Color){.r = 255, .g = 255, .b = 255, .a = 255};
+    ecfg.endColor = (Color){.r = 255, .g = 255, .b = 255, .a = 0};
+    ecfg.age = (FloatRange){.min = 0.5, .max = 1.0};
+    cfgs[1] = ecfg;
+
+    ecfg.capacity = 500;
+    ecfg.emissionRate = 100;
+    ecfg.directionAngle = (FloatRange){.min = -3, .max = 3};
+    ecfg.velocityAngle = (FloatRange){.min = 0, .max = 0};
+    ecfg.originAcceleration = (FloatRange){.min = 0, .max = 0};
+    ecfg.startColor = (Color){.r = 125, .g = 125, .b = 125, .a = 30};
+    ecfg.endColor = (Color){.r = 125, .g = 125, .b = 125, .a = 10};
+    ecfg.age = (FloatRange){.min = 3.0, .max = 5.0};
+    cfgs[2] = ecfg;
+
+    return 3;
+}
+
+static unsigned int PresetMuzzleFlash(EmitterConfig cfgs[PRESET_MAX_EMITTERS]) {
+    EmitterConfig ecfg = {
+        .capacity = 10,
+        .emissionRate = 0,
+        .burst = (IntRange){.min = 1, .max = 1},
+        .origin = (Vector2){.x = 0, .y = 0},
+        .originAcceleration = (FloatRange){.min = 0, .max = 0},
+        .offset = (FloatRange){.min = 0, .max = 0},
+        .direction = (Vector2){.x = 0, .y = 0}, // go up
+        .directionAngle = (FloatRange){.min = 0, .max = 0},
+        .velocityAngle = (FloatRange){.min = 0, .max = 0},
+        .velocity = (FloatRange){.min = 0, .max = 0},
+        .baseScale = (Vector2){1, 1},
+        .scaleIncrease = (Vector2){0, 2},
+        .startColor = (Color){.r = 255, .g = 20, .b = 0, .a = 255},
+        .endColor = (Color){.r = 255, .g = 20, .b = 0, .a = 0},
+        .age = (FloatRange){.min = 0.2, .max = 0.2},
+        .blendMode = BLEND_ADDITIVE,
+
+        .particle_Deactivator = Particle_DeactivatorFountain
+    };
+    cfgs[0] = ecfg;
+
+    return 1;
+}
+
+#endif // PARTIKEL_PRESETS_H
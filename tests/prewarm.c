@@ -0,0 +1,114 @@
+/*******************************************************************************************
+*
+*   libpartikel prewarm test - Compare a prewarmed Emitter to one updated frame by frame.
+*
+*   Prewarms Emitters that never fill up and Emitters that are full most of the time, with
+*   closed-form and integrated motion, and updates copies of them for the same time instead.
+*   Both must end with about the same amount of particles, the same ages and the same
+*   emissions left over.
+*
+*   libpartikel is licensed under an unmodified zlib/libpng license (View partikel.h for details)
+*
+********************************************************************************************/
+
+#include "math.h"
+#include "stdio.h"
+
+#define PARTIKEL_NO_RAYLIB
+#define LIBPARTIKEL_IMPLEMENTATION
+#include "partikel.h"
+
+#define SECONDS 5.0f
+#define FRAME_TIME (1.0f / 60)
+
+// Stats describes the particles of an Emitter.
+typedef struct Stats {
+    unsigned int length;
+    float meanAge;
+    float maxAge;
+    float mustEmit;
+} Stats;
+
+// Stats_Get returns the stats of e.
+static Stats Stats_Get(Emitter *e) {
+    Stats s = {.length = e->particles.length, .mustEmit = e->mustEmit};
+    double sum = 0;
+    for(unsigned int i = 0; i < s.length; i++) {
+        sum += e->particles.age[i];
+        s.maxAge = fmaxf(s.maxAge, e->particles.age[i]);
+    }
+    s.meanAge = s.length > 0 ? (float)(sum / s.length) : 0.0f;
+    return s;
+}
+
+// Near returns true if a and b differ by at most tolerance, relative to the larger of them.
+static bool Near(float a, float b, float tolerance) {
+    return fabsf(a - b) <= tolerance * fmaxf(fmaxf(fabsf(a), fabsf(b)), 1.0f);
+}
+
+// Compare prewarms and updates an Emitter with cfg and returns true if they match.
+static bool Compare(const char *name, EmitterConfig cfg) {
+    Emitter *stepped = Emitter_New(cfg);
+    Emitter *prewarmed = Emitter_New(cfg);
+    if(stepped == NULL || prewarmed == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return false;
+    }
+    Emitter_Start(stepped);
+    Emitter_Start(prewarmed);
+
+    for(int i = 0; i < (int)(SECONDS / FRAME_TIME + 0.5f); i++) {
+        Emitter_Update(stepped, FRAME_TIME);
+    }
+    Emitter_Prewarm(prewarmed, SECONDS);
+
+    Stats a = Stats_Get(stepped);
+    Stats b = Stats_Get(prewarmed);
+    bool ok = Near((float)a.length, (float)b.length, 0.05f) && Near(a.meanAge, b.meanAge, 0.1f)
+              && Near(a.maxAge, b.maxAge, 0.1f) && Near(a.mustEmit, b.mustEmit, 0.05f);
+    printf("%s %s: stepped %u particles, age %.3f mean %.3f max, %.1f due; "
+           "prewarmed %u particles, age %.3f mean %.3f max, %.1f due\n",
+           ok ? "ok" : "FAIL", name, a.length, a.meanAge, a.maxAge, a.mustEmit,
+           b.length, b.meanAge, b.maxAge, b.mustEmit);
+
+    Emitter_Free(stepped);
+    Emitter_Free(prewarmed);
+    return ok;
+}
+
+int main(void) {
+    EmitterConfig cfg = {
+        .capacity = 5000,
+        .emissionRate = 300,
+        .direction = (Vector2){.x = 0, .y = -1},
+        .velocity = (FloatRange){.min = 50, .max = 150},
+        .directionAngle = (FloatRange){.min = -30, .max = 30},
+        .externalAcceleration = (Vector2){.x = 0, .y = 90},
+        .baseScale = (Vector2){.x = 1, .y = 1},
+        .age = (FloatRange){.min = 0.5, .max = 2},
+        .seed = 7
+    };
+    EmitterConfig full = cfg;
+    full.capacity = 1000;
+    full.emissionRate = 3000;
+
+    struct {
+        const char *name;
+        ParticleMotion motion;
+        FloatRange originAcceleration;
+    } variants[] = {
+        {"integrated", PARTICLE_MOTION_INTEGRATED, {0, 0}},
+        {"ballistic", PARTICLE_MOTION_BALLISTIC, {0, 0}},
+        {"origin acceleration", PARTICLE_MOTION_INTEGRATED, {20, 40}},
+    };
+
+    bool ok = true;
+    for(size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); i++) {
+        cfg.motion = full.motion = variants[i].motion;
+        cfg.originAcceleration = full.originAcceleration = variants[i].originAcceleration;
+        printf("%s\n", variants[i].name);
+        ok = Compare("  not full", cfg) && ok;
+        ok = Compare("  full", full) && ok;
+    }
+    return ok ? 0 : 1;
+}
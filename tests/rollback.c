@@ -0,0 +1,93 @@
+/*******************************************************************************************
+*
+*   libpartikel rollback test - Restore a snapshot in fixed step mode and resimulate.
+*
+*   Updates a system with a frame time that is no multiple of its fixed step, takes a
+*   snapshot, updates further, restores the snapshot and repeats the same updates.
+*   Both runs must end in the same state, including the time carried over between
+*   updates and the lag particles are drawn with.
+*
+*   libpartikel is licensed under an unmodified zlib/libpng license (View partikel.h for details)
+*
+********************************************************************************************/
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+#define PARTIKEL_NO_RAYLIB
+#define LIBPARTIKEL_IMPLEMENTATION
+#include "partikel.h"
+
+#define FRAME_TIME (1.0f / 50)
+#define FIXED_STEP (1.0f / 30)
+#define WARMUP_FRAMES 37
+#define REPLAY_FRAMES 23
+
+// Replay runs the updates following the snapshot and returns the state they end in.
+static unsigned char * Replay(ParticleSystem *ps, size_t *size) {
+    for(int i = 0; i < REPLAY_FRAMES; i++) {
+        ParticleSystem_Update(ps, FRAME_TIME);
+    }
+    *size = ParticleSystem_Snapshot(ps, NULL, 0);
+    unsigned char *state = malloc(*size);
+    if(state != NULL) {
+        ParticleSystem_Snapshot(ps, state, *size);
+    }
+    return state;
+}
+
+int main(void) {
+    EmitterConfig cfg = {
+        .capacity = 2000,
+        .emissionRate = 300,
+        .direction = (Vector2){.x = 0, .y = -1},
+        .velocity = (FloatRange){.min = 50, .max = 150},
+        .directionAngle = (FloatRange){.min = -30, .max = 30},
+        .externalAcceleration = (Vector2){.x = 0, .y = 90},
+        .baseScale = (Vector2){.x = 1, .y = 1},
+        .rotationSpeed = (FloatRange){.min = -90, .max = 90},
+        .age = (FloatRange){.min = 0.5, .max = 2},
+        .seed = 7
+    };
+
+    ParticleSystem *ps = ParticleSystem_New();
+    Emitter *e = Emitter_New(cfg);
+    if(ps == NULL || e == NULL || !ParticleSystem_Register(ps, e)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    ParticleSystem_SetFixedStep(ps, FIXED_STEP);
+    ParticleSystem_Start(ps);
+
+    for(int i = 0; i < WARMUP_FRAMES; i++) {
+        ParticleSystem_Update(ps, FRAME_TIME);
+    }
+
+    size_t size = ParticleSystem_Snapshot(ps, NULL, 0);
+    unsigned char *snapshot = malloc(size);
+    if(snapshot == NULL || ParticleSystem_Snapshot(ps, snapshot, size) != size) {
+        fprintf(stderr, "snapshot failed\n");
+        return 1;
+    }
+
+    size_t firstSize, secondSize;
+    unsigned char *first = Replay(ps, &firstSize);
+    float firstLag = e->renderLag;
+
+    if(!ParticleSystem_Restore(ps, snapshot, size)) {
+        fprintf(stderr, "restore failed\n");
+        return 1;
+    }
+    unsigned char *second = Replay(ps, &secondSize);
+
+    int failed = first == NULL || second == NULL || firstSize != secondSize
+                 || memcmp(first, second, firstSize) != 0 || firstLag != e->renderLag;
+    printf("%s: %u particles, render lag %g\n", failed ? "FAIL" : "ok", e->particles.length, e->renderLag);
+
+    free(first);
+    free(second);
+    free(snapshot);
+    ParticleSystem_FreeAll(ps);
+    return failed;
+}